@@ -0,0 +1,518 @@
+/*
+  AnalogSampler.cpp - Interrupt driven ADC sampling for the Butterfly
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <avr/sleep.h>
+#include "wiring_private.h"
+
+#include "AnalogSampler.h"
+
+#define SAMPLER_STREAM 0
+#define SAMPLER_SCAN   1
+#define SAMPLER_QUIET  2
+
+static uint8_t sampler_mode;
+static uint8_t sampler_running = 0;
+
+static volatile unsigned int sampler_buffer[SAMPLER_BUFFER_SIZE];
+static volatile uint8_t sampler_head = 0;
+static volatile uint8_t sampler_tail = 0;
+static volatile uint8_t sampler_overruns = 0;
+static uint8_t sampler_trigger;
+
+// ADC prescale (ADPS2:0) to put back in end(), or 0xff if begin() hasn't
+// changed it
+static uint8_t sampler_saved_adps = 0xff;
+static uint8_t sampler_adps;
+
+// The fastest ADC clock begin() uses.  The datasheet gives 200KHz for full
+// 10 bit accuracy; a little over that costs well under a bit, and at 8MHz
+// allows /32 rather than /64.  The margin covers a trimmed clock that
+// lands slightly above its target.
+#define SAMPLER_ADC_CLOCK_MAX 265000L
+
+// Scan mode state.  The ISR fills scan_values[scan_front ^ 1] and flips
+// scan_front at the end of each pass; readers copy scan_values[scan_front]
+// and retry if scan_sequence moved while they were copying.
+static uint8_t scan_admux[SAMPLER_MAX_CHANNELS];
+static uint8_t scan_count;
+static uint8_t scan_index;
+static uint8_t scan_discard;
+static volatile unsigned int scan_values[2][SAMPLER_MAX_CHANNELS];
+static volatile uint8_t scan_front;
+static volatile uint8_t scan_sequence;
+static volatile uint8_t scan_ready;
+
+// Decimation stage; see decimate().  Each output is made from 4^n
+// conversions, where n is decimate_bits.  With a second order CIC filter
+// the integrators run freely and are left to wrap, which the comb stage
+// undoes as long as the result fits in 32 bits.
+static uint8_t decimate_bits = 0;
+static uint8_t decimate_order = 1;
+static uint8_t cic_order;
+static unsigned int decimate_left;
+static uint8_t decimate_settle;
+static uint32_t cic_integrator1, cic_integrator2;
+static uint32_t cic_comb1, cic_comb2;
+
+// Quiet mode state; see quiet_convert()
+static volatile uint8_t quiet_done;
+static volatile int quiet_value;
+
+// What readQuiet() interrupted, so it can be picked up again afterwards
+static uint8_t quiet_resume;
+static uint8_t quiet_admux;
+
+static void decimate_reset(uint8_t order)
+{
+  cic_order = order;
+  decimate_left = 1 << (decimate_bits << 1);
+  decimate_settle = order - 1;
+  cic_integrator1 = cic_integrator2 = 0;
+  cic_comb1 = cic_comb2 = 0;
+}
+
+// Adds a conversion to the current block and returns 1 when the block is
+// complete, leaving a 10 + n bit result in *out
+static inline uint8_t decimate(unsigned int v, unsigned int *out)
+{
+  uint32_t c1, c2;
+
+  cic_integrator1 += v;
+  if (cic_order == 2)
+    cic_integrator2 += cic_integrator1;
+
+  if (--decimate_left)
+    return 0;
+  decimate_left = 1 << (decimate_bits << 1);
+
+  if (cic_order == 2) {
+    // the comb stage; the gain is 16^n, so drop 3n bits to leave 10 + n
+    c1 = cic_integrator2 - cic_comb1;
+    cic_comb1 = cic_integrator2;
+    c2 = c1 - cic_comb2;
+    cic_comb2 = c1;
+
+    // the first output after a reset is built on an empty history
+    if (decimate_settle) {
+      decimate_settle--;
+      return 0;
+    }
+    *out = c2 >> (decimate_bits * 3);
+  } else {
+    // a plain sum of 4^n conversions has 10 + 2n bits; keep 10 + n
+    *out = cic_integrator1 >> decimate_bits;
+    cic_integrator1 = 0;
+  }
+
+  return 1;
+}
+
+static inline void stream_store(unsigned int v)
+{
+  uint8_t i = (sampler_head + 1) & (SAMPLER_BUFFER_SIZE - 1);
+
+  // Timer 1 flags aren't cleared by an ISR here, and the next conversion
+  // won't trigger until they are.
+  if (sampler_trigger == SAMPLER_TIMER1_COMPARE_B)
+    TIFR1 = _BV(OCF1B);
+  else if (sampler_trigger == SAMPLER_TIMER1_OVERFLOW)
+    TIFR1 = _BV(TOV1);
+
+  if (i != sampler_tail) {
+    sampler_buffer[sampler_head] = v;
+    sampler_head = i;
+  } else if (sampler_overruns < 255) {
+    sampler_overruns++;
+  }
+}
+
+static inline void scan_store(unsigned int v)
+{
+  uint8_t next;
+
+  // the first conversion after a reference change is unreliable, so it
+  // is thrown away and the channel converted again.  With decimation on,
+  // each channel is converted 4^n times before moving on to the next.
+  if (scan_discard) {
+    scan_discard = 0;
+  } else if (decimate(v, &v)) {
+    scan_values[scan_front ^ 1][scan_index] = v;
+    if (++scan_index == scan_count) {
+      scan_index = 0;
+      scan_front ^= 1;
+      scan_sequence++;
+      scan_ready = 1;
+    }
+
+    next = scan_admux[scan_index];
+    if ((next ^ ADMUX) & 0xc0)
+      scan_discard = 1;
+    ADMUX = next;
+  }
+
+  ADCSRA |= _BV(ADSC);
+}
+
+static inline void quiet_store(int v)
+{
+  if (!quiet_done) {
+    quiet_value = v;
+    quiet_done = 1;
+  }
+}
+
+ISR(ADC_vect)
+{
+  // ADCL must be read first; that locks ADCH until it is read too
+  uint8_t low = ADCL;
+  uint8_t high = ADCH;
+  unsigned int v = (high << 8) | low;
+
+  if (sampler_mode == SAMPLER_QUIET)
+    quiet_store(v);
+  else if (sampler_mode == SAMPLER_SCAN)
+    scan_store(v);
+  else if (decimate(v, &v))
+    stream_store(v);
+}
+
+// Stops conversions without giving up the ADC, waiting for one in progress
+static void sampler_stop(void)
+{
+  ADCSRA &= ~(_BV(ADATE) | _BV(ADIE));
+
+  // let a conversion in progress finish so the next one starts clean
+  while (bit_is_set(ADCSRA, ADSC))
+    ;
+  ADCSRA |= _BV(ADIF);
+}
+
+// Starts streaming conversions of the channel in admux
+static void stream_start(uint8_t admux)
+{
+  sampler_mode = SAMPLER_STREAM;
+  decimate_reset(decimate_order);
+  ADMUX = admux;
+
+  ADCSRB = (ADCSRB & ~(_BV(ADTS2) | _BV(ADTS1) | _BV(ADTS0))) |
+           (sampler_trigger & 0x07);
+
+  // In free running mode ADSC starts the first conversion and each one
+  // starts the next; otherwise the trigger does.
+  ADCSRA |= _BV(ADIF);
+  ADCSRA |= _BV(ADATE) | _BV(ADIE) |
+            (sampler_trigger == SAMPLER_FREE_RUNNING ? _BV(ADSC) : 0);
+}
+
+// Starts a scan pass from the first channel in scan_admux
+static void scan_start(void)
+{
+  // a second CIC stage would carry state over from one channel to the next
+  decimate_reset(1);
+
+  sampler_mode = SAMPLER_SCAN;
+  scan_index = 0;
+  scan_discard = (scan_admux[0] ^ ADMUX) & 0xc0;
+  ADMUX = scan_admux[0];
+
+  // single conversions, each started by the ISR once the mux is set
+  ADCSRB &= ~(_BV(ADTS2) | _BV(ADTS1) | _BV(ADTS0));
+  ADCSRA |= _BV(ADIF);
+  ADCSRA |= _BV(ADIE) | _BV(ADSC);
+}
+
+// Takes the ADC for quiet conversions.  A running stream or scan is paused
+// and picked up again by quiet_end(); its buffered results are kept.
+static void quiet_begin(uint8_t pin)
+{
+  quiet_resume = sampler_running ? sampler_mode : 0xff;
+  quiet_admux = ADMUX;
+  sampler_stop();
+
+  // convert at the ADC clock analogRead() uses, not the stream's
+  if (sampler_saved_adps != 0xff)
+    ADCSRA = (ADCSRA & ~(_BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0))) |
+             sampler_saved_adps;
+
+  sampler_mode = SAMPLER_QUIET;
+  ADMUX = (analog_reference << 6) | (pin & 0x0f);
+  ADCSRB &= ~(_BV(ADTS2) | _BV(ADTS1) | _BV(ADTS0));
+  ADCSRA |= _BV(ADIE);
+  set_sleep_mode(SLEEP_MODE_ADC);
+}
+
+static void quiet_end(void)
+{
+  uint8_t oldSREG = SREG;
+
+  cli();
+  ADCSRA &= ~_BV(ADIE);
+
+  // See quiet_convert(); a stray conversion may still be running
+  while (bit_is_set(ADCSRA, ADSC))
+    ;
+  ADCSRA |= _BV(ADIF);
+  SREG = oldSREG;
+
+  if (quiet_resume == SAMPLER_STREAM) {
+    ADCSRA = (ADCSRA & ~(_BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0))) |
+             sampler_adps;
+    stream_start(quiet_admux);
+  } else if (quiet_resume == SAMPLER_SCAN) {
+    scan_start();
+  }
+}
+
+// Does one conversion with the CPU asleep in ADC noise reduction mode, so
+// that neither it nor the I/O clock add noise to the result.
+static int quiet_convert(void)
+{
+  uint8_t adps = ADCSRA & (_BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0));
+  uint8_t oldSREG = SREG;
+
+  quiet_done = 0;
+
+  // The sleep stops the I/O clock, which would stall a byte the UART is
+  // sending, so while there is output in flight just wait awake.
+  if (serial_tx_busy()) {
+    ADCSRA |= _BV(ADSC);
+    sei();
+    while (!quiet_done)
+      ;
+    SREG = oldSREG;
+    return quiet_value;
+  }
+
+  // Entering the sleep starts the conversion.  Timer 0 stops with the I/O
+  // clock so it can't wake us, but the LCD, Timer 2 and pin change
+  // interrupts still can; the conversion carries on regardless, so just
+  // go back to sleep until ADC_vect has run.  If the conversion finishes
+  // right before a re-sleep, that sleep starts another one; quiet_store()
+  // ignores it and quiet_end() waits for it.
+  cli();
+  do {
+    sleep_enable();
+    sei();
+    sleep_cpu();
+    sleep_disable();
+    cli();
+  } while (!quiet_done);
+  SREG = oldSREG;
+
+  // Timer 0 was stopped for about 13.5 ADC clocks; put that time back so
+  // millis() doesn't fall behind
+  timer0_skip((27U << (adps ? adps : 1)) >> 1);
+
+  return quiet_value;
+}
+
+// Public Methods //////////////////////////////////////////////////////////////
+
+void AnalogSampler::begin(uint8_t pin, uint8_t trigger)
+{
+  end();
+
+  sampler_head = sampler_tail = 0;
+  sampler_overruns = 0;
+  sampler_trigger = trigger;
+
+  // init() picks an ADC clock of at most 200KHz, /64 at 8MHz, which free
+  // runs at under 10k samples per second.  Speed it up for streaming and
+  // put it back in end().
+  sampler_adps = 1;
+  while ((clockCyclesPerSecond() >> sampler_adps) > SAMPLER_ADC_CLOCK_MAX &&
+         sampler_adps < 7)
+    sampler_adps++;
+  sampler_saved_adps = ADCSRA & (_BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0));
+  ADCSRA = (ADCSRA & ~(_BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0))) | sampler_adps;
+
+  // select the reference and channel the same way analogRead() does
+  stream_start((analog_reference << 6) | (pin & 0x0f));
+  sampler_running = 1;
+}
+
+void AnalogSampler::end(void)
+{
+  sampler_stop();
+  sampler_running = 0;
+
+  if (sampler_saved_adps != 0xff) {
+    ADCSRA = (ADCSRA & ~(_BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0))) |
+             sampler_saved_adps;
+    sampler_saved_adps = 0xff;
+  }
+}
+
+// Converts each of the count channels in turn, forever, keeping the latest
+// result for each.  If references is given, references[i] is used for
+// channels[i]; otherwise they all use the analogReference() setting.
+void AnalogSampler::scan(const uint8_t *channels, uint8_t count,
+                         const uint8_t *references)
+{
+  uint8_t i;
+
+  end();
+
+  if (count > SAMPLER_MAX_CHANNELS)
+    count = SAMPLER_MAX_CHANNELS;
+  if (count == 0)
+    return;
+
+  for (i = 0; i < count; i++) {
+    scan_admux[i] = ((references ? references[i] : analog_reference) << 6) |
+                    (channels[i] & 0x0f);
+  }
+
+  scan_count = count;
+  scan_front = 0;
+  scan_ready = 0;
+  scan_start();
+  sampler_running = 1;
+}
+
+uint8_t AnalogSampler::available(void)
+{
+  return (sampler_head - sampler_tail) & (SAMPLER_BUFFER_SIZE - 1);
+}
+
+// Returns the oldest sample, or -1 if the buffer is empty
+long AnalogSampler::read(void)
+{
+  unsigned int v;
+
+  if (sampler_head == sampler_tail)
+    return -1;
+
+  // the ISR never writes the slot at the tail, so this needs no locking
+  v = sampler_buffer[sampler_tail];
+  sampler_tail = (sampler_tail + 1) & (SAMPLER_BUFFER_SIZE - 1);
+  return v;
+}
+
+// Copies up to count samples into buffer and returns how many were copied
+uint8_t AnalogSampler::read(unsigned int *buffer, uint8_t count)
+{
+  uint8_t head = sampler_head;
+  uint8_t tail = sampler_tail;
+  uint8_t n = 0;
+
+  while (n < count && tail != head) {
+    buffer[n++] = sampler_buffer[tail];
+    tail = (tail + 1) & (SAMPLER_BUFFER_SIZE - 1);
+  }
+  sampler_tail = tail;
+
+  return n;
+}
+
+// Number of samples dropped because the buffer was full
+uint8_t AnalogSampler::overruns(void)
+{
+  return sampler_overruns;
+}
+
+// Latest result for entry index of the scan list, or -1 if no full pass
+// has completed yet
+long AnalogSampler::value(uint8_t index)
+{
+  uint8_t sequence;
+  unsigned int v;
+
+  if (!scan_ready)
+    return -1;
+
+  do {
+    sequence = scan_sequence;
+    v = scan_values[scan_front][index];
+  } while (sequence != scan_sequence);
+
+  return v;
+}
+
+// Copies the latest results for the whole scan list, all from the same
+// pass, into values and returns the number of entries, or 0 if no full
+// pass has completed yet
+uint8_t AnalogSampler::snapshot(unsigned int *values)
+{
+  uint8_t sequence;
+  uint8_t front;
+  uint8_t i;
+
+  if (!scan_ready)
+    return 0;
+
+  do {
+    sequence = scan_sequence;
+    front = scan_front;
+    for (i = 0; i < scan_count; i++)
+      values[i] = scan_values[front][i];
+  } while (sequence != scan_sequence);
+
+  return scan_count;
+}
+
+// Makes each result from 4^bits conversions, giving 10 + bits of
+// resolution at 1/4^bits of the conversion rate; bits of 0 turns this off.
+// order 1 sums each block of conversions (a boxcar filter); order 2 adds a
+// second CIC stage, which rejects more noise around the output rate but
+// only works with begin() and up to 5 bits.  Takes effect at the next
+// begin() or scan().
+void AnalogSampler::decimate(uint8_t bits, uint8_t order)
+{
+  if (order > 1 && bits > 5)
+    bits = 5;
+  else if (bits > 6)
+    bits = 6;
+
+  decimate_bits = bits;
+  decimate_order = order > 1 ? 2 : 1;
+}
+
+// Returns the sum of count conversions of pin, each made in ADC noise
+// reduction sleep.  Summing several keeps the extra resolution that
+// averaging them would throw away.
+unsigned long AnalogSampler::readQuiet(uint8_t pin, unsigned int count)
+{
+  unsigned long sum = 0;
+
+  quiet_begin(pin);
+  while (count--)
+    sum += quiet_convert();
+  quiet_end();
+
+  return sum;
+}
+
+int analogReadQuiet(uint8_t pin)
+{
+  return Sampler.readQuiet(pin, 1);
+}
+
+// Adds bits (1 to 6) of resolution to a reading of pin by summing 4^bits
+// quiet conversions and scaling the sum back by 2^bits.  This needs some
+// noise on the input to work; the Butterfly's sensors have plenty.
+unsigned int analogReadHighRes(uint8_t pin, uint8_t bits)
+{
+  if (bits > 6)
+    bits = 6;
+  return Sampler.readQuiet(pin, 1 << (bits << 1)) >> bits;
+}
+
+// Preinstantiate Objects //////////////////////////////////////////////////////
+
+AnalogSampler Sampler = AnalogSampler();
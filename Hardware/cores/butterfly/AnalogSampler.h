@@ -0,0 +1,86 @@
+/*
+  AnalogSampler.h - Interrupt driven ADC sampling for the Butterfly
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef AnalogSampler_h
+#define AnalogSampler_h
+
+#include <inttypes.h>
+
+// Number of samples buffered between reads; must be a power of two.
+#define SAMPLER_BUFFER_SIZE 64
+
+// Longest channel list scan() accepts
+#define SAMPLER_MAX_CHANNELS 8
+
+// What starts each conversion.  These are the ADC auto trigger sources
+// (ADTS2:0).  Free running converts back to back, 13 ADC clocks each;
+// begin() raises the ADC clock to at most about 250KHz while the sampler
+// runs, which at 8MHz is about 19k samples per second.
+#define SAMPLER_FREE_RUNNING      0
+#define SAMPLER_TIMER0_OVERFLOW   4
+#define SAMPLER_TIMER1_COMPARE_B  5
+#define SAMPLER_TIMER1_OVERFLOW   6
+
+// Runs the ADC in auto trigger mode and collects each result in ADC_vect,
+// so the CPU is free while conversions are in progress.  Samples are kept
+// in a ring buffer until the sketch reads them; if it falls behind, new
+// samples are dropped and counted in overruns().
+//
+// Alternatively scan() converts a list of channels in rotation and keeps
+// the latest result for each, so a sketch can pick up TEMP, VOLT and
+// LIGHT with value() or snapshot() instead of waiting on analogRead().
+//
+// decimate() makes each result from a block of 4^n conversions, for up to
+// 16 bits of resolution at a lower rate.  The filtering is done in the
+// ISR, so the sketch only sees the finished results.
+//
+// readQuiet() and analogReadQuiet() make each conversion with the CPU
+// asleep in ADC noise reduction mode, which gives quieter results than
+// analogRead() and uses less power while waiting.  A running stream or
+// scan is paused while they convert and then carries on; a stream loses
+// the decimation block it was part way through.  The sleep stops the I/O
+// clock for each conversion, about 110us at 8MHz, which holds up timer 1
+// (tone() and PWM on SPEAKER and JOYA) and can spoil a byte being
+// received on the serial port.  Output is safe: while a byte is being
+// sent they convert awake instead, without the noise reduction.  TempSense
+// reads the sensor this way.
+//
+// analogRead() must not be used while the sampler is running.
+class AnalogSampler
+{
+  public:
+    void begin(uint8_t pin, uint8_t trigger = SAMPLER_FREE_RUNNING);
+    void scan(const uint8_t *channels, uint8_t count,
+              const uint8_t *references = 0);
+    void end(void);
+    uint8_t available(void);
+    long read(void);
+    uint8_t read(unsigned int *buffer, uint8_t count);
+    uint8_t overruns(void);
+    long value(uint8_t index);
+    uint8_t snapshot(unsigned int *values);
+    void decimate(uint8_t bits, uint8_t order = 1);
+    unsigned long readQuiet(uint8_t pin, unsigned int count);
+};
+
+extern AnalogSampler Sampler;
+
+int analogReadQuiet(uint8_t pin);
+unsigned int analogReadHighRes(uint8_t pin, uint8_t bits);
+
+#endif
@@ -43,15 +43,22 @@ int HardwareSerial::read(void)
   return serialRead();
 }
 
+// Waits for everything written so far to be sent.  serialFlush() still
+// discards unread input.
 void HardwareSerial::flush()
 {
-  serialFlush();
+  serialDrain();
 }
 
 void HardwareSerial::write(uint8_t b) {
   serialWrite(b);
 }
 
+void HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+  serialWriteBuffer(buffer, size);
+}
+
 // Preinstantiate Objects //////////////////////////////////////////////////////
 
 HardwareSerial Serial = HardwareSerial();
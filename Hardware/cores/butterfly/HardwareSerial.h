@@ -21,8 +21,27 @@
 #define HardwareSerial_h
 
 #include <inttypes.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
 
 #include "Print.h"
+#include "RingBuffer.h"
+
+// The receive buffer holds 128 bytes.  A sketch that needs the RAM, or
+// more buffering, can pick another power of two up to 256 by putting
+//
+//   SERIAL_RX_BUFFER(32);
+//
+// at the top level.  That defines the buffer, the receive interrupt and
+// the functions that read it; the linker then leaves out the default
+// ones in wiring_serial_rx.cpp.
+#define SERIAL_RX_BUFFER(N) \
+  static RingBuffer<N> serial_rx_buffer; \
+  SIGNAL(SIG_UART_RECV) { serial_rx_buffer.put(UDR); } \
+  int serialAvailable(void) { return serial_rx_buffer.available(); } \
+  int serialRead(void) { return serial_rx_buffer.get(); } \
+  void serialFlush(void) { serial_rx_buffer.clear(); } \
+  typedef char serial_rx_buffer_size_##N
 
 class HardwareSerial : public Print
 {
@@ -32,6 +51,7 @@ class HardwareSerial : public Print
     int read(void);
     void flush(void);
     virtual void write(uint8_t);
+    virtual void write(const uint8_t *, size_t);
 };
 
 extern HardwareSerial Serial;
@@ -0,0 +1,192 @@
+/*
+  InputCapture.cpp - Timer 1 input capture on ICP1 for the Butterfly
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "wiring_private.h"
+
+#include "InputCapture.h"
+
+// Widths are stored with the level of the pulse in the top bit.
+#define CAPTURE_HIGH 0x80000000UL
+
+static volatile unsigned long capture_buffer[CAPTURE_BUFFER_SIZE];
+static volatile uint8_t capture_head = 0;
+static volatile uint8_t capture_tail = 0;
+static volatile uint8_t capture_overruns = 0;
+
+static volatile uint16_t capture_overflows = 0;
+static volatile unsigned long capture_last = 0;
+static volatile uint8_t capture_started = 0;
+
+static uint8_t saved_tccr1a, saved_tccr1b;
+static uint16_t saved_icr1;
+
+ISR(TIMER1_OVF_vect)
+{
+  capture_overflows++;
+}
+
+ISR(TIMER1_CAPT_vect)
+{
+  uint16_t icr = ICR1;
+  uint16_t high = capture_overflows;
+  uint8_t rising = TCCR1B & _BV(ICES1);
+  unsigned long now;
+
+  // Look for the opposite edge next.  The capture flag has to be cleared
+  // after changing the edge, or the change itself may register as an edge.
+  TCCR1B ^= _BV(ICES1);
+  TIFR1 = _BV(ICF1);
+
+  // If the timer overflowed before this capture, but the overflow hasn't
+  // been counted yet (the capture interrupt has priority), count it here.
+  if ((TIFR1 & _BV(TOV1)) && icr < 0x8000)
+    high++;
+
+  now = ((unsigned long)high << 16) | icr;
+
+  // The first edge only starts the clock; after that every edge ends a
+  // pulse.  A rising edge ends a low pulse.
+  if (capture_started) {
+    unsigned long width = (now - capture_last) & ~CAPTURE_HIGH;
+    uint8_t i = (capture_head + 1) & (CAPTURE_BUFFER_SIZE - 1);
+
+    if (!rising)
+      width |= CAPTURE_HIGH;
+
+    if (i != capture_tail) {
+      capture_buffer[capture_head] = width;
+      capture_head = i;
+    } else if (capture_overruns < 255) {
+      capture_overruns++;
+    }
+  }
+
+  capture_started = 1;
+  capture_last = now;
+}
+
+// Public Methods //////////////////////////////////////////////////////////////
+
+void InputCapture::begin(uint8_t noiseCanceler)
+{
+  uint8_t oldSREG = SREG;
+
+  cli();
+
+  saved_tccr1a = TCCR1A;
+  saved_tccr1b = TCCR1B;
+  // every capture overwrites ICR1, which pwmConfigure() may be using as top
+  saved_icr1 = ICR1;
+
+  capture_head = capture_tail = 0;
+  capture_overruns = 0;
+  capture_overflows = 0;
+  capture_started = 0;
+
+  // ICP1 is an input
+  DDRD &= ~_BV(0);
+
+  // Normal mode, no prescaling, so a timestamp is a clock cycle count.  Wait
+  // for whichever edge the pin will make next.  The noise canceler requires
+  // four equal samples, which delays both edges alike.
+  TCCR1A = 0;
+  TCCR1B = _BV(CS10) | (noiseCanceler ? _BV(ICNC1) : 0) |
+           ((PIND & _BV(0)) ? 0 : _BV(ICES1));
+  TCNT1 = 0;
+
+  TIFR1 = _BV(ICF1) | _BV(TOV1);
+  TIMSK1 = _BV(ICIE1) | _BV(TOIE1);
+
+  SREG = oldSREG;
+}
+
+void InputCapture::end(void)
+{
+  uint8_t oldSREG = SREG;
+
+  cli();
+  TIMSK1 &= ~(_BV(ICIE1) | _BV(TOIE1));
+
+  // put timer 1 back the way it was, e.g. the PWM set up by init()
+  timer1_load(saved_tccr1a, saved_tccr1b, saved_icr1, OCR1A, OCR1B);
+  SREG = oldSREG;
+}
+
+uint8_t InputCapture::available(void)
+{
+  return (capture_head - capture_tail) & (CAPTURE_BUFFER_SIZE - 1);
+}
+
+// Returns the width of the next buffered pulse in clock cycles, or 0 if none
+// is waiting.  If state is given, the level of the pulse (HIGH or LOW) is
+// stored there.
+unsigned long InputCapture::read(uint8_t *state)
+{
+  unsigned long width;
+  uint8_t oldSREG;
+
+  if (capture_head == capture_tail)
+    return 0;
+
+  // the width is four bytes, so don't let the ISR change it under us
+  oldSREG = SREG;
+  cli();
+  width = capture_buffer[capture_tail];
+  SREG = oldSREG;
+  capture_tail = (capture_tail + 1) & (CAPTURE_BUFFER_SIZE - 1);
+
+  if (state)
+    *state = (width & CAPTURE_HIGH) ? HIGH : LOW;
+
+  return width & ~CAPTURE_HIGH;
+}
+
+// Number of pulses dropped because the buffer was full
+uint8_t InputCapture::overruns(void)
+{
+  return capture_overruns;
+}
+
+unsigned long pulseInCapture(uint8_t state, unsigned long timeout)
+{
+  unsigned long start = micros();
+  unsigned long width = 0;
+  uint8_t level;
+
+  Capture.begin();
+
+  // the first complete pulse of the right level is the one we want
+  while (micros() - start <= timeout) {
+    if (Capture.available()) {
+      width = Capture.read(&level);
+      if (level == state)
+        break;
+      width = 0;
+    }
+  }
+
+  Capture.end();
+
+  return clockCyclesToMicroseconds(width);
+}
+
+// Preinstantiate Objects //////////////////////////////////////////////////////
+
+InputCapture Capture = InputCapture();
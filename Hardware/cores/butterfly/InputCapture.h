@@ -0,0 +1,53 @@
+/*
+  InputCapture.h - Timer 1 input capture on ICP1 for the Butterfly
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef InputCapture_h
+#define InputCapture_h
+
+#include <inttypes.h>
+
+// Number of pulse widths buffered between calls to read(); must be a
+// power of two.
+#define CAPTURE_BUFFER_SIZE 16
+
+// Timer 1 timestamps every edge on ICP1 (PD0, pin PDPIN1) in hardware, so
+// the widths are exact to a clock cycle no matter what other interrupts are
+// doing.  Both edges are captured, and the time between each pair is put in
+// a ring buffer.  Timer overflows are counted to extend the widths to 32
+// bits.
+//
+// While capturing, timer 1 runs in normal mode, so PWM on SPEAKER and JOYA
+// stops until end().  PD0 is also an LCD segment pin; it can only be used
+// here if the LCD driver isn't using it.
+class InputCapture
+{
+  public:
+    void begin(uint8_t noiseCanceler = 1);
+    void end(void);
+    uint8_t available(void);
+    unsigned long read(uint8_t *state = 0);
+    uint8_t overruns(void);
+};
+
+extern InputCapture Capture;
+
+// Like pulseIn(), but timed by the capture hardware on ICP1.  Returns the
+// width in microseconds, or 0 if no pulse completed within the timeout.
+unsigned long pulseInCapture(uint8_t state, unsigned long timeout = 1000000L);
+
+#endif
@@ -28,6 +28,14 @@
 
 // Public Methods //////////////////////////////////////////////////////////////
 
+// Writes a run of bytes.  Subclasses that can take a whole run more
+// cheaply than one byte at a time should override this.
+void Print::write(const uint8_t *buffer, size_t size)
+{
+  while (size--)
+    write(*buffer++);
+}
+
 void Print::print(uint8_t b)
 {
   this->write(b);
@@ -40,8 +48,26 @@ void Print::print(char c)
 
 void Print::print(const char c[])
 {
-  while (*c)
-    print(*c++);
+  write((const uint8_t *) c, strlen(c));
+}
+
+// Strings in flash are read into a small buffer and written a piece at a
+// time, so they still reach write() in runs.
+void Print::print(const __FlashStringHelper *s)
+{
+  const char *p = (const char *) s;
+  uint8_t buf[16];
+  uint8_t n;
+  char c;
+
+  do {
+    n = 0;
+    while (n < sizeof(buf) && (c = pgm_read_byte(p)) != 0) {
+      buf[n++] = c;
+      p++;
+    }
+    write(buf, n);
+  } while (n == sizeof(buf));
 }
 
 void Print::print(int n)
@@ -80,8 +106,7 @@ void Print::print(long n, int base)
 
 void Print::println(void)
 {
-  print('\r');
-  print('\n');  
+  write((const uint8_t *) "\r\n", 2);
 }
 
 void Print::println(char c)
@@ -96,6 +121,12 @@ void Print::println(const char c[])
   println();
 }
 
+void Print::println(const __FlashStringHelper *s)
+{
+  print(s);
+  println();
+}
+
 void Print::println(uint8_t b)
 {
   print(b);
@@ -134,23 +165,100 @@ void Print::println(long n, int base)
 
 // Private Methods /////////////////////////////////////////////////////////////
 
+// AVR has no divide instruction, and the library's 32 bit divide takes
+// hundreds of cycles, so decimal digits come from these instead.  The
+// shifts and adds estimate n * 0.8, which shifted down three places is
+// n / 10 or one short of it; the remainder shows which.
+static inline unsigned long divmod10(unsigned long n, uint8_t *rem)
+{
+  unsigned long q = (n >> 1) + (n >> 2);
+  q += q >> 4;
+  q += q >> 8;
+  q += q >> 16;
+  q >>= 3;
+  uint8_t r = n - ((q << 2) + q) * 2;
+  if (r > 9) {
+    q++;
+    r -= 10;
+  }
+  *rem = r;
+  return q;
+}
+
+// the same with 16 bits, where the q >> 16 term is always zero
+static inline unsigned int divmod10(unsigned int n, uint8_t *rem)
+{
+  unsigned int q = (n >> 1) + (n >> 2);
+  q += q >> 4;
+  q += q >> 8;
+  q >>= 3;
+  uint8_t r = n - ((q << 2) + q) * 2;
+  if (r > 9) {
+    q++;
+    r -= 10;
+  }
+  *rem = r;
+  return q;
+}
+
+// and with 8, where one hardware multiply does it: n * 205 / 2048 is
+// exactly n / 10 for n up to 1028
+static inline uint8_t divmod10(uint8_t n, uint8_t *rem)
+{
+  uint8_t q = ((unsigned int) n * 205) >> 11;
+  *rem = n - q * 10;
+  return q;
+}
+
 void Print::printNumber(unsigned long n, uint8_t base)
 {
   unsigned char buf[8 * sizeof(long)]; // Assumes 8-bit chars. 
-  unsigned long i = 0;
+  uint8_t i = sizeof(buf);
+  uint8_t digit;
+
+  if (base < 2)
+    base = 10;
+
+  // fill the buffer from the end so the digits come out in order and
+  // can be written as one run
+  if (base == 10) {
+    // use the narrowest divide the number fits, so an int only ever
+    // takes the 16 and 8 bit paths
+    unsigned int m;
+    uint8_t b;
 
-  if (n == 0) {
-    print('0');
-    return;
-  } 
+    while (n > 0xFFFF) {
+      n = divmod10(n, &digit);
+      buf[--i] = '0' + digit;
+    }
+    m = n;
+    while (m > 0xFF) {
+      m = divmod10(m, &digit);
+      buf[--i] = '0' + digit;
+    }
+    b = m;
+    do {
+      b = divmod10(b, &digit);
+      buf[--i] = '0' + digit;
+    } while (b > 0);
+  } else if ((base & (base - 1)) == 0) {
+    // powers of two need only a mask and a shift per digit
+    uint8_t shift = 0;
 
-  while (n > 0) {
-    buf[i++] = n % base;
-    n /= base;
+    while ((1 << shift) < base)
+      shift++;
+    do {
+      digit = n & (base - 1);
+      n >>= shift;
+      buf[--i] = digit < 10 ? '0' + digit : 'A' + digit - 10;
+    } while (n > 0);
+  } else {
+    do {
+      digit = n % base;
+      n /= base;
+      buf[--i] = digit < 10 ? '0' + digit : 'A' + digit - 10;
+    } while (n > 0);
   }
 
-  for (; i > 0; i--)
-    print((char) (buf[i - 1] < 10 ?
-      '0' + buf[i - 1] :
-      'A' + buf[i - 1] - 10));
+  write(buf + i, sizeof(buf) - i);
 }
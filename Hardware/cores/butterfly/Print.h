@@ -21,6 +21,8 @@
 #define Print_h
 
 #include <inttypes.h>
+#include <stddef.h>
+#include <avr/pgmspace.h>
 
 #define DEC 10
 #define HEX 16
@@ -28,14 +30,25 @@
 #define BIN 2
 #define BYTE 0
 
+// Wrapping a string literal in F() leaves it in flash, where print()
+// reads it a byte at a time, instead of having it copied into RAM at
+// startup like other literals.  It only works inside a function:
+//
+//   Serial.println(F("Hello"));
+class __FlashStringHelper;
+#define F(string_literal) \
+  (reinterpret_cast<const __FlashStringHelper *>(PSTR(string_literal)))
+
 class Print
 {
   private:
     void printNumber(unsigned long, uint8_t);
   public:
     virtual void write(uint8_t);
+    virtual void write(const uint8_t *, size_t);
     void print(char);
     void print(const char[]);
+    void print(const __FlashStringHelper *);
     void print(uint8_t);
     void print(int);
     void print(unsigned int);
@@ -45,6 +58,7 @@ class Print
     void println(void);
     void println(char);
     void println(const char[]);
+    void println(const __FlashStringHelper *);
     void println(uint8_t);
     void println(int);
     void println(unsigned int);
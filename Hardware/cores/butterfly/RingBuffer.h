@@ -0,0 +1,83 @@
+/*
+  RingBuffer.h - Byte queue between an interrupt and the main program
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef RingBuffer_h
+#define RingBuffer_h
+
+#include <inttypes.h>
+
+// A single producer, single consumer queue of N bytes, where N is a power
+// of two from 2 to 256.  The indices are single bytes and wrap with a mask,
+// so reading either one is atomic and no division is needed.  The producer
+// only writes head and the consumer only writes tail, so one side can be
+// an ISR without either having to turn interrupts off.  One slot is kept
+// empty to tell a full queue from an empty one.
+//
+// Leave instances at file scope; they're plain data, so they start out
+// empty without needing a constructor.
+template <unsigned int N>
+class RingBuffer
+{
+  // fails to compile if N isn't a power of two that fits the indices
+  typedef char size_must_be_a_power_of_two_up_to_256
+    [(N >= 2 && N <= 256 && (N & (N - 1)) == 0) ? 1 : -1];
+
+  public:
+    uint8_t buffer[N];
+    volatile uint8_t head;
+    volatile uint8_t tail;
+
+    uint8_t available(void)
+    {
+      return (uint8_t)(head - tail) & (N - 1);
+    }
+
+    // Adds c unless the queue is full; returns false if it was
+    bool put(uint8_t c)
+    {
+      uint8_t h = head;
+      uint8_t i = (h + 1) & (N - 1);
+
+      if (i == tail)
+        return false;
+      buffer[h] = c;
+      head = i;
+      return true;
+    }
+
+    // Removes and returns the oldest byte, or -1 if there isn't one
+    int get(void)
+    {
+      uint8_t t = tail;
+      uint8_t c;
+
+      if (head == t)
+        return -1;
+      c = buffer[t];
+      tail = (t + 1) & (N - 1);
+      return c;
+    }
+
+    // Discards everything queued; for the consumer side
+    void clear(void)
+    {
+      tail = head;
+    }
+};
+
+#endif
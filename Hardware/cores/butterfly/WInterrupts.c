@@ -79,6 +79,98 @@ void detachInterrupt(uint8_t interruptNum) {
   }
 }
 
+#if defined(__AVR_ATmega169__)
+// Pin change interrupts.  PCINT0-7 are on PORTE and PCINT8-15 on PORTB;
+// each port has one interrupt vector shared by its eight pins.  The ISR
+// compares the port with the state it saw last time, masks the changed
+// bits down to the edges that were asked for, and calls only those
+// handlers, so its cost is bounded by the number of pins that fire.
+volatile static voidFuncPtr pcintFunc[16];
+static uint8_t pcintRising[2];
+static uint8_t pcintFalling[2];
+static uint8_t pcintLast[2];
+
+void attachPinChangeInterrupt(uint8_t pcint, void (*userFunc)(void), int mode) {
+  uint8_t port = pcint >> 3;
+  uint8_t bit = 1 << (pcint & 7);
+  uint8_t oldSREG = SREG;
+
+  if (pcint >= 16 || mode == LOW)
+    return;
+
+  cli();
+  pcintFunc[pcint] = userFunc;
+
+  if (mode == RISING || mode == CHANGE) pcintRising[port] |= bit;
+  else pcintRising[port] &= ~bit;
+  if (mode == FALLING || mode == CHANGE) pcintFalling[port] |= bit;
+  else pcintFalling[port] &= ~bit;
+
+  // Take the current level of this pin only, so an edge that came in on
+  // another pin just before this isn't lost.
+  if (port) {
+    pcintLast[1] = (pcintLast[1] & ~bit) | (PINB & bit);
+    PCMSK1 |= bit;
+    EIFR = (1 << PCIF1);
+    EIMSK |= (1 << PCIE1);
+  } else {
+    pcintLast[0] = (pcintLast[0] & ~bit) | (PINE & bit);
+    PCMSK0 |= bit;
+    EIFR = (1 << PCIF0);
+    EIMSK |= (1 << PCIE0);
+  }
+  SREG = oldSREG;
+}
+
+void detachPinChangeInterrupt(uint8_t pcint) {
+  uint8_t port = pcint >> 3;
+  uint8_t bit = 1 << (pcint & 7);
+  uint8_t oldSREG = SREG;
+
+  if (pcint >= 16)
+    return;
+
+  cli();
+  pcintRising[port] &= ~bit;
+  pcintFalling[port] &= ~bit;
+
+  // Disable the port's interrupt once no pins on it are armed.
+  if (port) {
+    PCMSK1 &= ~bit;
+    if (!PCMSK1) EIMSK &= ~(1 << PCIE1);
+  } else {
+    PCMSK0 &= ~bit;
+    if (!PCMSK0) EIMSK &= ~(1 << PCIE0);
+  }
+  pcintFunc[pcint] = 0;
+  SREG = oldSREG;
+}
+
+static inline void pcintDispatch(uint8_t port, uint8_t now) __attribute__ ((always_inline));
+static inline void pcintDispatch(uint8_t port, uint8_t now) {
+  uint8_t fired = now ^ pcintLast[port];
+  volatile voidFuncPtr *func = &pcintFunc[port << 3];
+
+  pcintLast[port] = now;
+  fired &= (now & pcintRising[port]) | (~now & pcintFalling[port]);
+
+  while (fired) {
+    if ((fired & 1) && *func)
+      (*func)();
+    fired >>= 1;
+    func++;
+  }
+}
+
+SIGNAL(SIG_PIN_CHANGE0) {
+  pcintDispatch(0, PINE);
+}
+
+SIGNAL(SIG_PIN_CHANGE1) {
+  pcintDispatch(1, PINB);
+}
+#endif
+
 /*
 void attachInterruptTwi(void (*userFunc)(void) ) {
   twiIntFunc = userFunc;
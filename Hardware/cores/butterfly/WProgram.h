@@ -11,8 +11,11 @@
 
 #ifdef __cplusplus
 #include "HardwareSerial.h"
+#include "InputCapture.h"
+#include "AnalogSampler.h"
 
 unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout = 1000000L);
+void tone(uint8_t pin, unsigned int frequency, unsigned long duration = 0);
 
 // WMath prototypes
 long random(long);
@@ -1,14 +1,56 @@
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
 #include "osccal.h"
+#include "wiring.h"
 
-void OSCCAL_Calibrate(void)
+volatile int32_t OSCCAL_Drift;
+volatile int8_t  OSCCAL_Nudges;
+
+static uint32_t OSCCAL_LastMicros;
+static uint8_t  OSCCAL_Tracking;
+
+// Timer 2 clock select (CS22:0) to crystal prescale
+static const uint16_t PROGMEM OSCCAL_T2Prescale[] = {0, 1, 8, 32, 64, 128, 256, 1024};
+
+// Counts CPU clock cycles over one crystal period. Timer 2 must have just
+// overflowed (the caller waited on TOV2), so the measurement starts on an
+// overflow edge and the next one ends it.
+static uint16_t OSCCAL_Measure(void)
+{
+   // Restart timer 1 from zero in step with timer 2
+   TCNT1  = 0;
+   TIFR1  = (1 << TOV1);
+   TIFR2  = (1 << TOV2);
+
+   // Wait until timer 2 overflows
+   while (!(TIFR2 & (1 << TOV2)));
+
+   // A clock fast enough to wrap timer 1 must not look like a slow one
+   if (TIFR1 & (1 << TOV1))
+      return 0xFFFF;
+
+   return TCNT1;
+}
+
+uint16_t OSCCAL_Calibrate(void)
 {
-   uint8_t LoopCount = (0x7F / 2); // Maximum range is 128, and starts from the middle, so 64 is the max number of iterations required
+   uint16_t Count;
+   uint16_t Error;
+   uint16_t BestError = 0xFFFF;
+   uint16_t BestCount = 0;
+   uint8_t  BestCal;
+   uint8_t  Cal;
+   uint8_t  Bit;
+
+   // The cached value is stored with its complement so that blank or
+   // corrupted EEPROM is not mistaken for a calibration
+   Cal = eeprom_read_byte(OSCCAL_EEPROM_ADDR);
+   BestCal = Cal;
+   if ((Cal > 0x7F) || (eeprom_read_byte(OSCCAL_EEPROM_ADDR + 1) != (uint8_t)~Cal))
+      Cal = 0xFF;
 
    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
    {   
-      // Inital OSCCAL of half its maximum
-      OSCCAL = (0x7F / 2);
-      
       // Disable timer interrupts
       TIMSK1 = 0;
       TIMSK2 = 0;
@@ -26,33 +68,44 @@ void OSCCAL_Calibrate(void)
       // Wait until timer 2's external 32.768KHz crystal is stable
       while (ASSR & ((1 << TCN2UB) | (1 << TCR2UB) | (1 << OCR2UB)));
       
-      // Clear the timer values
-      TCNT1  = 0;
-      TCNT2  = 0;
-   
-      while (LoopCount--)
+      // Line up with the first overflow so every measurement covers a
+      // whole crystal period
+      TIFR2  = (1 << TOV2);
+      while (!(TIFR2 & (1 << TOV2)));
+
+      // Try the cached value first; if the clock is still within tolerance
+      // one crystal period is all the calibration needs
+      if (Cal != 0xFF)
       {
-         // Wait until timer 2 overflows
-         while (!(TIFR2 & (1 << TOV2)));
-      
-         // Stop timer 1 so it can be read
-         TCCR1B = 0x00;
-         
-         // Check timer value against ideal constant
-         if (TCNT1 > OSCCAL_TARGETCOUNT)      // Clock is running too fast
-           OSCCAL--;
-         else if (TCNT1 < OSCCAL_TARGETCOUNT) // Clock is running too slow
-           OSCCAL++;
+         OSCCAL = Cal;
+         BestCount = OSCCAL_Measure();
+         BestError = (BestCount > OSCCAL_TARGETCOUNT) ? (BestCount - OSCCAL_TARGETCOUNT)
+                                                      : (OSCCAL_TARGETCOUNT - BestCount);
+      }
+
+      if (BestError > OSCCAL_TOLERANCE)
+      {
+         // Binary search the 7-bit OSCCAL range, keeping a bit whenever the
+         // clock is still at or below the target. Remember the closest
+         // setting seen on the way, since the last one tried may be over.
+         Cal = 0;
+         for (Bit = 0x40; Bit; Bit >>= 1)
+         {
+            OSCCAL = Cal | Bit;
+            Count = OSCCAL_Measure();
+            Error = (Count > OSCCAL_TARGETCOUNT) ? (Count - OSCCAL_TARGETCOUNT)
+                                                 : (OSCCAL_TARGETCOUNT - Count);
+            if (Count <= OSCCAL_TARGETCOUNT) // Clock is running too slow
+              Cal |= Bit;
+            if (Error < BestError)
+            {
+              BestError = Error;
+              BestCount = Count;
+              BestCal   = Cal | Bit;
+            }
+         }
          
-         // Clear timer 2 overflow flag
-         TIFR2 |= (1 << TOV2);
-   
-         // Restart timer 1
-         TCCR1B = (1 << CS10);
-   
-         // Reset counters
-         TCNT1  = 0;
-         TCNT2  = 0;
+         OSCCAL = BestCal;
       }
    
       // Stop the timers
@@ -64,5 +117,87 @@ void OSCCAL_Calibrate(void)
    }   
    END_ATOMIC_BLOCK
    
-   return;
-} 
+   // Only write the cache when it changes, to spare the EEPROM. Check the
+   // complement too, or a bad one would fail the check on every reset
+   if ((OSCCAL != eeprom_read_byte(OSCCAL_EEPROM_ADDR)) ||
+       ((uint8_t)~OSCCAL != eeprom_read_byte(OSCCAL_EEPROM_ADDR + 1)))
+   {
+      eeprom_write_byte(OSCCAL_EEPROM_ADDR, OSCCAL);
+      eeprom_write_byte(OSCCAL_EEPROM_ADDR + 1, (uint8_t)~OSCCAL);
+   }
+   
+   // Clock cycles counted in a crystal period (1/128 second) at the
+   // chosen setting
+   return BestCount;
+}
+
+/*
+   Drift compensation runs alongside an asynchronous timer 2 that is already
+   counting the crystal, such as the one Timer2RTC sets up. Call
+   OSCCAL_TrackStart() once, then OSCCAL_Track() from each timer 2 overflow.
+   Each period the time micros() has counted is compared to the crystal
+   period, and OSCCAL is moved one step when they disagree by more than
+   about 0.4%. No timer is reconfigured, so PWM and the RTC are undisturbed.
+*/
+void OSCCAL_TrackStart(void)
+{
+   OSCCAL_Drift    = 0;
+   OSCCAL_Nudges   = 0;
+   OSCCAL_Tracking = 0;
+}
+
+void OSCCAL_Track(void)
+{
+   uint32_t Now = micros();
+   uint32_t Elapsed = Now - OSCCAL_LastMicros;
+   uint32_t Expected;
+   int32_t  Error;
+
+   OSCCAL_LastMicros = Now;
+
+   // The first overflow only sets the starting point
+   if (!OSCCAL_Tracking)
+   {
+      OSCCAL_Tracking = 1;
+      return;
+   }
+
+   // A crystal tick is 15625/512 uS. Timer 2 overflows every 256 prescaled
+   // ticks in normal and fast PWM mode, but every 510 in the phase correct
+   // mode init() leaves it in, as it counts up and back down
+   Expected = pgm_read_word(&OSCCAL_T2Prescale[TCCR2A & 0x07]);
+   switch (TCCR2A & ((1 << WGM21) | (1 << WGM20)))
+   {
+      case 0:                                     // Normal
+      case (1 << WGM21) | (1 << WGM20):           // Fast PWM
+         Expected = (Expected * 15625UL) >> 1;
+         break;
+      case (1 << WGM20):                          // Phase correct PWM
+         Expected = (Expected * 255UL * 15625UL) >> 8;
+         break;
+      default:                                    // CTC, the period depends on OCR2A
+         Expected = 0;
+   }
+   if (Expected == 0)
+      return;
+
+   Error = (int32_t)(Elapsed - Expected);
+
+   // An error of more than about 6% is not drift; most likely an overflow
+   // was missed or the timer was reconfigured, so leave OSCCAL alone
+   if ((Error > (int32_t)(Expected >> 4)) || (-Error > (int32_t)(Expected >> 4)))
+      return;
+
+   OSCCAL_Drift += Error;
+
+   if ((Error > (int32_t)(Expected >> 8)) && (OSCCAL > 0))            // Clock is running too fast
+   {
+      OSCCAL--;
+      OSCCAL_Nudges--;
+   }
+   else if ((-Error > (int32_t)(Expected >> 8)) && (OSCCAL < 0x7F))   // Clock is running too slow
+   {
+      OSCCAL++;
+      OSCCAL_Nudges++;
+   }
+}
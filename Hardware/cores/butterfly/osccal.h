@@ -16,8 +16,34 @@
 
    // CONFIG DEFINES:
    #define OSCCAL_TARGETCOUNT         (uint16_t)(F_CPU / (32768 / 256)) // (Target Freq / Reference Freq)   
+   #define OSCCAL_TOLERANCE           (OSCCAL_TARGETCOUNT / 100)         // Cached value is used if within 1%
+
+   // The cached calibration takes two bytes of EEPROM: the OSCCAL value and
+   // its complement. They default to the last two bytes (E2END - 1 and
+   // E2END), which sketches writing the EEPROM must leave alone. Define
+   // OSCCAL_EEPROM_ADDR when building the core to move them elsewhere.
+   #ifndef OSCCAL_EEPROM_ADDR
+   #define OSCCAL_EEPROM_ADDR         ((uint8_t *)(E2END - 1))
+   #endif
    
    // PROTOTYPES:
-   void OSCCAL_Calibrate(void);
+   #ifdef __cplusplus
+   extern "C"{
+   #endif
+
+   uint16_t OSCCAL_Calibrate(void);
+   void     OSCCAL_TrackStart(void);
+   void     OSCCAL_Track(void);
+
+   // Microseconds the CPU clock has gained (positive) or lost (negative)
+   // against the crystal since OSCCAL_TrackStart()
+   extern volatile int32_t OSCCAL_Drift;
+
+   // Net number of steps OSCCAL_Track() has moved OSCCAL
+   extern volatile int8_t  OSCCAL_Nudges;
+
+   #ifdef __cplusplus
+   }
+   #endif
    
 #endif 
@@ -90,9 +90,9 @@
 //
 //
 
-#define PB 2
-#define PD 3
-#define PF 4
+#define PB PBPORT
+#define PD PDPORT
+#define PF PFPORT
 
 // these arrays map port names (e.g. port B) to the
 // appropriate addresses for various functions (e.g. reading
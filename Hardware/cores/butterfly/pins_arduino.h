@@ -62,4 +62,13 @@ extern const uint8_t PROGMEM digital_pin_to_timer_PGM[];
 #define portInputRegister(P) ( (volatile uint8_t *)( pgm_read_byte( port_to_input_PGM + (P))) )
 #define portModeRegister(P) ( (volatile uint8_t *)( pgm_read_byte( port_to_mode_PGM + (P))) )
 
+// Compile-time equivalents of the lookups above, for use when the pin
+// number is a constant.  These follow the tables in pins_arduino.c and
+// must be kept in step with them.
+#define NUM_DIGITAL_PINS 20
+#define digitalPinToPortReg(P) ( (P) <= 7 ? &PORTB : ( (P) <= 15 ? &PORTD : &PORTF ) )
+#define digitalPinToDDRReg(P) ( (P) <= 7 ? &DDRB : ( (P) <= 15 ? &DDRD : &DDRF ) )
+#define digitalPinToPINReg(P) ( (P) <= 7 ? &PINB : ( (P) <= 15 ? &PIND : &PINF ) )
+#define digitalPinToBit(P) ( (P) <= 15 ? ( (P) & 7 ) : ( (P) - 12 ) )
+
 #endif
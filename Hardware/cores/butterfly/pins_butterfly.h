@@ -14,6 +14,11 @@
 // USI
 //      PORTB  JTAG  PORTD     ISP
 
+// Port numbers for portMode(), portWrite() and portRead()
+#define PBPORT 2
+#define PDPORT 3
+#define PFPORT 4
+
 // *** PORTB ***
 #define PBPIN1 0         // PB Pad 1 PB0(/SS)
 #define PBPIN2 1         // PB Pad 2 PB1(SCK) DataFlash, ISP
@@ -54,4 +59,13 @@
 #define JTAGPIN7 19 // JTAG Pad 7 PF7 (TDI/ADC7)
 #define ADC7 7
 
+// Pin change interrupt numbers for attachPinChangeInterrupt().
+// PCINT0-7 are PE0-PE7 and PCINT8-15 are PB0-PB7, i.e. pin number + 8.
+#define digitalPinToPCINT(P) ( (P) <= 7 ? (P) + 8 : 0xFF )
+#define PCINT_JOYLEFT    2  // PE2 Joystick left
+#define PCINT_JOYRIGHT   3  // PE3 Joystick right
+#define PCINT_JOYCENTER 12  // PB4 Joystick center
+#define PCINT_JOYA      14  // PB6 Joystick A (up)
+#define PCINT_JOYB      15  // PB7 Joystick B (down)
+
 #endif
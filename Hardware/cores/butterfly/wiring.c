@@ -25,17 +25,93 @@
 #include "wiring_private.h"
 #include "osccal.h"
 
-volatile unsigned long timer0_clock_cycles = 0;
+#ifdef CLOCK_IS_MEASURED
+#warning "F_CPU is not a power-of-two division of 8MHz; timing will follow the clock measured at init()"
+
+unsigned long clock_cycles_per_second = F_CPU;
+unsigned int clock_cycles_per_us_q8 = (F_CPU * 256ULL) / 1000000ULL;
+
+// these are worked out once in init() from the measured clock, so that the
+// overflow handler and delayMicroseconds() never have to divide.
+static unsigned long timer0_overflow_us;
+static unsigned int timer0_millis_inc;
+static unsigned int timer0_fract_inc;
+static unsigned int delay_loops_q8;
+
+#define MICROSECONDS_PER_TIMER0_OVERFLOW timer0_overflow_us
+#define MILLIS_INC timer0_millis_inc
+#define FRACT_INC timer0_fract_inc
+#define DELAY_LOOPS_PER_US_Q8 delay_loops_q8
+#else
+// the prescaler is set so that timer0 ticks every 64 clock cycles, and
+// the overflow handler is called every 256 ticks.
+#define MICROSECONDS_PER_TIMER0_OVERFLOW \
+	((unsigned long)((64ULL * 256ULL * 1000000ULL) / F_CPU))
+
+// the whole number of milliseconds per timer0 overflow
+#define MILLIS_INC (MICROSECONDS_PER_TIMER0_OVERFLOW / 1000)
+
+// the fractional number of milliseconds per timer0 overflow, in whole
+// microseconds.  a measured clock gives any number of them, so they are
+// kept in 16 bits rather than shifted down to fit a byte.
+#define FRACT_INC (MICROSECONDS_PER_TIMER0_OVERFLOW % 1000)
+
+// iterations of the 4 cycle delayMicroseconds() loop per microsecond, as
+// 8.8 fixed point so that clocks under 4MHz don't round down to zero
+#define DELAY_LOOPS_PER_US_Q8 (F_CPU / 15625L)
+#endif
+
+#define FRACT_MAX 1000
+
 volatile unsigned long timer0_millis = 0;
+static unsigned int timer0_fract = 0;
+
+static inline void timer0_overflow(void)
+{
+	// copy these to local variables so they can be stored in registers
+	// (volatile variables must be read from memory on every access)
+	unsigned long m = timer0_millis;
+	unsigned int f = timer0_fract;
+
+	m += MILLIS_INC;
+	f += FRACT_INC;
+	if (f >= FRACT_MAX) {
+		f -= FRACT_MAX;
+		m += 1;
+	}
+
+	timer0_fract = f;
+	timer0_millis = m;
+
+	if (tone_timed && (long)(m - tone_end) >= 0)
+		tone_expire();
+}
 
 SIGNAL(SIG_OVERFLOW0)
 {
-	// timer 0 prescale factor is 64 and the timer overflows at 256
-	timer0_clock_cycles += 64UL * 256UL;
-	while (timer0_clock_cycles > clockCyclesPerMicrosecond() * 1000UL) {
-		timer0_clock_cycles -= clockCyclesPerMicrosecond() * 1000UL;
-		timer0_millis++;
+	timer0_overflow();
+}
+
+/* Accounts for clock cycles during which timer0 was stopped, e.g. in ADC
+ * noise reduction sleep where the I/O clock is halted, by moving TCNT0 on
+ * and counting any overflows that would have happened.  Cycles short of a
+ * whole tick are carried over to the next call. */
+void timer0_skip(unsigned int cycles)
+{
+	static unsigned char remainder = 0;
+	unsigned int t;
+	uint8_t oldSREG = SREG;
+
+	cli();
+	cycles += remainder;
+	remainder = cycles & 63;
+	t = TCNT0 + (cycles >> 6);
+	while (t > 255) {
+		timer0_overflow();
+		t -= 256;
 	}
+	TCNT0 = t;
+	SREG = oldSREG;
 }
 
 unsigned long millis()
@@ -52,6 +128,31 @@ unsigned long millis()
 	return m;
 }
 
+unsigned long micros()
+{
+	unsigned long m, us;
+	unsigned int f;
+	unsigned char t;
+	uint8_t oldSREG = SREG;
+	
+	cli();
+	m = timer0_millis;
+	f = timer0_fract;
+	t = TCNT0;
+
+	// if the counter has wrapped but the overflow handler hasn't run yet
+	// (we're inside cli()), account for the pending overflow.  a count of
+	// 255 means the flag is left over from before this reading.
+	us = 0;
+	if ((TIFR0 & _BV(TOV0)) && (t < 255))
+		us = MICROSECONDS_PER_TIMER0_OVERFLOW;
+	SREG = oldSREG;
+	
+	// each timer0 tick is 1/256th of an overflow period
+	return m * 1000 + f + us +
+		(((unsigned long)t * MICROSECONDS_PER_TIMER0_OVERFLOW) >> 8);
+}
+
 void delay(unsigned long ms)
 {
 	unsigned long start = millis();
@@ -60,7 +161,9 @@ void delay(unsigned long ms)
 		;
 }
 
-/* Delay for the given number of microseconds.  Assumes a 8 or 16 MHz clock. 
+/* Delay for the given number of microseconds.  The busy loop is scaled to
+ * clockCyclesPerSecond(), so it holds at whatever prescale CLKPR_Calibrate()
+ * picked; at low clock rates short delays are dominated by call overhead.
  * Disables interrupts, which will disrupt the millis() function if used
  * too frequently. */
 void delayMicroseconds(unsigned int us)
@@ -71,41 +174,15 @@ void delayMicroseconds(unsigned int us)
 	// 2 microseconds) gives delays longer than desired.
 	//delay_us(us);
 
-#if F_CPU >= 16000000L
-	// for the 16 MHz clock on most Arduino boards
-
-	// for a one-microsecond delay, simply return.  the overhead
-	// of the function call yields a delay of approximately 1 1/8 us.
-	if (--us == 0)
-		return;
-
-	// the following loop takes a quarter of a microsecond (4 cycles)
-	// per iteration, so execute it four times for each microsecond of
-	// delay requested.
-	us <<= 2;
-
-	// account for the time taken in the preceeding commands.
-	us -= 2;
-#else
-	// for the 8 MHz internal clock on the ATmega168
+	// convert the delay into iterations of the loop below.
+	us = ((unsigned long)us * DELAY_LOOPS_PER_US_Q8) >> 8;
 
-	// for a one- or two-microsecond delay, simply return.  the overhead of
-	// the function calls takes more than two microseconds.  can't just
-	// subtract two, since us is unsigned; we'd overflow.
-	if (--us == 0)
-		return;
-	if (--us == 0)
+	// account for the time taken by the call and the conversion, roughly
+	// six iterations' worth.  can't just subtract, since us is unsigned;
+	// we'd overflow.
+	if (us <= 6)
 		return;
-
-	// the following loop takes half of a microsecond (4 cycles)
-	// per iteration, so execute it twice for each microsecond of
-	// delay requested.
-	us <<= 1;
-    
-	// partially compensate for the time taken by the preceeding commands.
-	// we can't subtract any more than this or we'd overflow w/ small delays.
-	us--;
-#endif
+	us -= 6;
 
 	// disable interrupts, otherwise the timer 0 overflow interrupt that
 	// tracks milliseconds will make us delay longer than we want.
@@ -125,27 +202,12 @@ void delayMicroseconds(unsigned int us)
 void CLKPR_Calibrate(void)
 {
   // The Butterfly has an internal 8MHz clock. If F_CPU is not 8MHz then
-  // the clock prescale can be used to divide down the internal clock. This
-  // tries to get as close to the target frequency as possible.
- 
-  int clkprx = 0;
-  // 8000000 is Butterfly internal clock
-  // B1000 is maximum allowed scale
-  while (( (8000000/(1<<clkprx) ) > F_CPU) && (clkprx < B1000))
-    clkprx++;
-
-  if ((clkprx < B1000)   // B1000 is as low as it goes, leave it. 
-   && (clkprx > B0000))  // B0000 is as high as it goes, leave it.  
-  {
-    // Check whether clkprx or clkprx-1 is closer to the target
-    if ( (F_CPU-(8000000/(1<<clkprx))) > ((8000000/(1<<(clkprx-1)))-F_CPU)){
-      clkprx--;
-    }
-  }
+  // the clock prescale can be used to divide down the internal clock.
+  // wiring.h works out the division that gets closest to the target.
   
   // Reset clock prescale
   CLKPR = (1 << CLKPCE);
-  CLKPR = clkprx;
+  CLKPR = CLKPR_PRESCALE;
 }
 
 void init()
@@ -154,7 +216,18 @@ void init()
     CLKPR_Calibrate();
     // Then trim the RC oscillator to get as close to the 
     // requested clock frequency as possible. 
+#ifdef CLOCK_IS_MEASURED
+    // The trim may not have been able to reach F_CPU; derive everything
+    // that has to be fast from the clock it actually got to.
+    clock_cycles_per_second = OSCCAL_Calibrate() * (32768UL / 256);
+    timer0_overflow_us = (15625UL << 14) / (clock_cycles_per_second >> 6);
+    timer0_millis_inc = timer0_overflow_us / 1000;
+    timer0_fract_inc = timer0_overflow_us % 1000;
+    delay_loops_q8 = clock_cycles_per_second / 15625L;
+    clock_cycles_per_us_q8 = clock_cycles_per_second * 16 / 62500L;
+#else
     OSCCAL_Calibrate();
+#endif
     
 	// this needs to be called before setup() or some functions won't
 	// work there
@@ -191,9 +264,9 @@ void init()
 
 	// Find an A2D prescale that is <= 200KHz
 	int adpsx = 0;
-	while ((F_CPU/(1<<++adpsx))>200000)
+	while ((clockCyclesPerSecond()/(1<<++adpsx))>200000)
 	   ;
-    ADCSRA = (ADCSRA&~(1<<ADPS0|1<<ADPS0|1<<ADPS0)) | adpsx;   
+    ADCSRA = (ADCSRA&~(1<<ADPS0|1<<ADPS1|1<<ADPS2)) | adpsx;   
 
 	// enable a2d conversions
 	sbi(ADCSRA, ADEN);
@@ -205,6 +278,6 @@ void init()
 	
 	// The butterfly bootloader leaves PCIE1 set, but unless there
 	// is a handler installed for it, the device will reset on joystick
-	// center or up.
+	// center or up.  attachPinChangeInterrupt() turns it back on.
 	cbi( EIMSK, PCIE1 );
 }
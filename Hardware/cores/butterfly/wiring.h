@@ -28,6 +28,7 @@
 #include <avr/io.h>
 #include "binary.h"
 #include "pins_butterfly.h" 
+#include "pins_arduino.h"
 
 #ifdef __cplusplus
 extern "C"{
@@ -86,9 +87,68 @@ extern "C"{
 #define interrupts() sei()
 #define noInterrupts() cli()
 
-#define clockCyclesPerMicrosecond() ( F_CPU / 1000000L )
-#define clockCyclesToMicroseconds(a) ( (a) / clockCyclesPerMicrosecond() )
-#define microsecondsToClockCycles(a) ( (a) * clockCyclesPerMicrosecond() )
+// The Butterfly runs from its 8MHz internal RC oscillator. CLKPR_Calibrate()
+// divides it by the power of two nearest F_CPU, then OSCCAL_Calibrate() trims
+// the oscillator the rest of the way. Work the division out here so the rest
+// of the core can use it as a constant.
+#if F_CPU > 6000000L
+#define CLKPR_PRESCALE 0
+#elif F_CPU > 3000000L
+#define CLKPR_PRESCALE 1
+#elif F_CPU > 1500000L
+#define CLKPR_PRESCALE 2
+#elif F_CPU > 750000L
+#define CLKPR_PRESCALE 3
+#elif F_CPU > 375000L
+#define CLKPR_PRESCALE 4
+#elif F_CPU > 187500L
+#define CLKPR_PRESCALE 5
+#elif F_CPU > 93750L
+#define CLKPR_PRESCALE 6
+#elif F_CPU > 46875L
+#define CLKPR_PRESCALE 7
+#else
+#define CLKPR_PRESCALE 8
+#endif
+
+// When F_CPU is an exact division of 8MHz the oscillator only needs a small
+// trim to hit it, and all timing is computed at compile time. Otherwise the
+// trim may run out of range, so timing follows the clock OSCCAL_Calibrate()
+// measured against the 32.768KHz crystal during init().
+#if F_CPU == (8000000L >> CLKPR_PRESCALE)
+#define clockCyclesPerSecond() ( F_CPU )
+#else
+#define CLOCK_IS_MEASURED
+extern unsigned long clock_cycles_per_second;
+#define clockCyclesPerSecond() ( clock_cycles_per_second )
+#endif
+
+#define clockCyclesPerMicrosecond() ( clockCyclesPerSecond() / 1000000L )
+
+// Clock cycles per microsecond as 8.8 fixed point.  Clocks below 1MHz, and
+// measured clocks that aren't a whole number of MHz, would round down in
+// clockCyclesPerMicrosecond(), so the conversions below use this instead.
+// For the exact divisions of 8MHz it is a power of two and they reduce to
+// shifts.
+#ifdef CLOCK_IS_MEASURED
+extern unsigned int clock_cycles_per_us_q8;
+#define clockCyclesPerMicrosecondQ8() ( clock_cycles_per_us_q8 )
+#else
+#define clockCyclesPerMicrosecondQ8() \
+	( (unsigned int)((F_CPU * 256ULL) / 1000000ULL) )
+#endif
+
+static inline unsigned long clockCyclesToMicroseconds(unsigned long a)
+{
+	unsigned int q8 = clockCyclesPerMicrosecondQ8();
+	return (a / q8) * 256 + ((a % q8) * 256) / q8;
+}
+
+static inline unsigned long microsecondsToClockCycles(unsigned long a)
+{
+	unsigned int q8 = clockCyclesPerMicrosecondQ8();
+	return (a >> 8) * q8 + (((a & 0xff) * q8) >> 8);
+}
 
 typedef uint8_t boolean;
 typedef uint8_t byte;
@@ -98,15 +158,52 @@ void init(void);
 void pinMode(uint8_t, uint8_t);
 void digitalWrite(uint8_t, uint8_t);
 int digitalRead(uint8_t);
+void portMode(uint8_t, uint8_t, uint8_t);
+void portWrite(uint8_t, uint8_t, uint8_t);
+uint8_t portRead(uint8_t);
 int analogRead(uint8_t);
 void analogReference(uint8_t mode);
 void analogWrite(uint8_t, int);
+void analogWriteResolution(uint8_t);
+uint8_t pwmConfigure(uint8_t, uint8_t, unsigned long);
+void softPwmBegin(unsigned int);
+uint8_t softPwmWrite(uint8_t, uint8_t);
+void softPwmEnd(void);
+void tone(uint8_t, unsigned int, unsigned long);
+void noTone(uint8_t);
+
+// Versions of pinMode(), digitalWrite() and digitalRead() that compile down
+// to a single sbi/cbi/sbic instruction when the pin number is a constant.
+// With a variable pin number they fall back on the functions above.  Unlike
+// digitalWrite(), these leave a PWM output on the pin connected.
+#define pinModeFast(P, V) \
+	do { \
+		if (__builtin_constant_p(P) && (P) < NUM_DIGITAL_PINS) { \
+			if ((V) == INPUT) *digitalPinToDDRReg(P) &= ~_BV(digitalPinToBit(P)); \
+			else *digitalPinToDDRReg(P) |= _BV(digitalPinToBit(P)); \
+		} else pinMode((P), (V)); \
+	} while (0)
+
+#define digitalWriteFast(P, V) \
+	do { \
+		if (__builtin_constant_p(P) && (P) < NUM_DIGITAL_PINS) { \
+			if ((V) == LOW) *digitalPinToPortReg(P) &= ~_BV(digitalPinToBit(P)); \
+			else *digitalPinToPortReg(P) |= _BV(digitalPinToBit(P)); \
+		} else digitalWrite((P), (V)); \
+	} while (0)
+
+#define digitalReadFast(P) \
+	( (__builtin_constant_p(P) && (P) < NUM_DIGITAL_PINS) ? \
+		( (*digitalPinToPINReg(P) & _BV(digitalPinToBit(P))) ? HIGH : LOW ) : \
+		digitalRead((P)) )
 
 void beginSerial(long);
 void serialWrite(unsigned char);
+void serialWriteBuffer(const unsigned char *, unsigned int);
 int serialAvailable(void);
 int serialRead(void);
 void serialFlush(void);
+void serialDrain(void);
 void printMode(int);
 void printByte(unsigned char c);
 void printNewline(void);
@@ -118,14 +215,61 @@ void printBinary(unsigned long n);
 void printIntegerInBase(unsigned long n, unsigned long base);
 
 unsigned long millis(void);
+unsigned long micros(void);
 void delay(unsigned long);
 void delayMicroseconds(unsigned int us);
 unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout);
 
 void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, byte val);
+uint8_t shiftIn(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder);
+uint8_t spiShift(uint8_t bitOrder, uint8_t val);
+uint8_t usiShift(uint8_t bitOrder, uint8_t val);
+
+// With constant pin numbers, shiftOut() and shiftIn() are expanded in place
+// using the fast pin macros, at a few cycles per bit.  Otherwise they call
+// the functions in wiring_shift.c.
+#define shiftOut(dataPin, clockPin, bitOrder, val) \
+	do { \
+		if (__builtin_constant_p(dataPin) && __builtin_constant_p(clockPin) && \
+		    (dataPin) < NUM_DIGITAL_PINS && (clockPin) < NUM_DIGITAL_PINS) { \
+			uint8_t __val = (val); \
+			uint8_t __i; \
+			for (__i = 0; __i < 8; __i++) { \
+				if ((bitOrder) == LSBFIRST) { \
+					digitalWriteFast((dataPin), __val & 0x01); \
+					__val >>= 1; \
+				} else { \
+					digitalWriteFast((dataPin), __val & 0x80); \
+					__val <<= 1; \
+				} \
+				digitalWriteFast((clockPin), HIGH); \
+				digitalWriteFast((clockPin), LOW); \
+			} \
+		} else shiftOut((dataPin), (clockPin), (bitOrder), (val)); \
+	} while (0)
+
+#define shiftIn(dataPin, clockPin, bitOrder) \
+	({ \
+		uint8_t __val = 0; \
+		if (__builtin_constant_p(dataPin) && __builtin_constant_p(clockPin) && \
+		    (dataPin) < NUM_DIGITAL_PINS && (clockPin) < NUM_DIGITAL_PINS) { \
+			uint8_t __i; \
+			for (__i = 0; __i < 8; __i++) { \
+				digitalWriteFast((clockPin), HIGH); \
+				if ((bitOrder) == LSBFIRST) \
+					__val |= digitalReadFast(dataPin) << __i; \
+				else \
+					__val |= digitalReadFast(dataPin) << (7 - __i); \
+				digitalWriteFast((clockPin), LOW); \
+			} \
+		} else __val = shiftIn((dataPin), (clockPin), (bitOrder)); \
+		__val; \
+	})
 
 void attachInterrupt(uint8_t, void (*)(void), int mode);
 void detachInterrupt(uint8_t);
+void attachPinChangeInterrupt(uint8_t, void (*)(void), int mode);
+void detachPinChangeInterrupt(uint8_t);
 
 void setup(void);
 void loop(void);
@@ -64,41 +64,178 @@ int analogRead(uint8_t pin)
 	return (high << 8) | low;
 }
 
-// Right now, PWM output only works on the pins with
-// hardware support.  These are defined in the appropriate
-// pins_*.c file.  For the rest of the pins, we default
-// to digital output.
-void analogWrite(uint8_t pin, int val)
+// The range of values analogWrite() takes, and the top of timer 1's count.
+// init() leaves timer 1 in 8 bit phase correct mode; pwmConfigure() can
+// move it to an ICR1-topped mode with a longer count.
+static uint8_t analog_write_bits = 8;
+static unsigned int timer1_top = 255;
+
+static const uint16_t timer1_prescale[] = { 1, 8, 64, 256, 1024 };
+
+uint8_t (*softpwm_write)(uint8_t, uint8_t) = 0;
+
+void analogWriteResolution(uint8_t bits)
+{
+	if (bits < 1)
+		bits = 1;
+	if (bits > 16)
+		bits = 16;
+	analog_write_bits = bits;
+}
+
+/* Loads timer 1 with a complete setup and restarts it from the bottom.
+ * ICR1 can only be written in a mode that uses it as top, and in the PWM
+ * modes OCR1A/B writes go to a buffer that is copied over at the end of a
+ * period, so the compare values are written once in normal mode, straight
+ * into the compare registers, and again once the mode is set.  Call with
+ * interrupts off. */
+void timer1_load(uint8_t tccr1a, uint8_t tccr1b, uint16_t icr1,
+	uint16_t ocr1a, uint16_t ocr1b)
+{
+	TCCR1B = 0;
+	TCCR1A = 0;
+	OCR1A = ocr1a;
+	OCR1B = ocr1b;
+	TCCR1A = tccr1a;
+	TCCR1B = tccr1b & (_BV(WGM13) | _BV(WGM12));
+	ICR1 = icr1;
+	OCR1A = ocr1a;
+	OCR1B = ocr1b;
+	TCNT1 = 0;
+	TCCR1B = tccr1b;
+}
+
+/* Sets the resolution and frequency of the PWM on the timer 1 pins
+ * (SPEAKER and JOYA; both share the timer, so both change).  Picks the
+ * smallest prescale whose count at this frequency is at least bits long,
+ * using phase correct PWM like init() when it can and fast PWM, which runs
+ * twice as fast for the same count, when it can't.  ICR1 sets the top of
+ * the count, so the frequency is exact to within a clock.  The duty cycles
+ * already set are kept.  analogWrite() values are scaled to the new top
+ * from the range set by analogWriteResolution(), which applies to every
+ * PWM pin and so isn't changed here; call it with the same number of bits
+ * to use the full resolution.  Returns 0 if the frequency can't be reached
+ * with that many bits. */
+uint8_t pwmConfigure(uint8_t pin, uint8_t bits, unsigned long frequency)
 {
+	uint8_t timer = digitalPinToTimer(pin);
+	unsigned long need, top = 0;
+	uint8_t cs, fast = 0;
+	uint8_t oldSREG;
+	uint16_t a, b;
+
+	if (timer != TIMER1A && timer != TIMER1B)
+		return 0;
+	if (bits < 8 || bits > 16 || frequency == 0)
+		return 0;
+
+	need = (1UL << bits) - 1;
+	for (cs = 0; cs < 5; cs++) {
+		// phase correct counts up and down: f = clk / (2 * N * top)
+		top = clockCyclesPerSecond() / (2UL * timer1_prescale[cs] * frequency);
+		if (top >= need && top <= 65535UL)
+			break;
+		// fast counts up only: f = clk / (N * (top + 1))
+		top = clockCyclesPerSecond() / ((unsigned long)timer1_prescale[cs] * frequency) - 1;
+		if (top >= need && top <= 65535UL) {
+			fast = 1;
+			break;
+		}
+	}
+	if (cs == 5)
+		return 0;
+
+	oldSREG = SREG;
+	cli();
+
+	// keep each duty cycle as the same fraction of the period
+	a = ((unsigned long)OCR1A * (top + 1)) / ((unsigned long)timer1_top + 1);
+	b = ((unsigned long)OCR1B * (top + 1)) / ((unsigned long)timer1_top + 1);
+	if (a > top) a = top;
+	if (b > top) b = top;
+
+	// WGM 10 is phase correct, WGM 14 fast; both top at ICR1
+	timer1_load((TCCR1A & (_BV(COM1A1) | _BV(COM1B1))) | _BV(WGM11),
+		_BV(WGM13) | (fast ? _BV(WGM12) : 0) | (cs + 1), top, a, b);
+	timer1_top = top;
+
+	SREG = oldSREG;
+
+	return 1;
+}
+
+// Maps an analogWrite() value onto a count of top + 1 steps, with the
+// largest value giving a pin that is high all the time.
+static unsigned int pwm_scale(unsigned int val, unsigned int top)
+{
+	unsigned int max = (analog_write_bits == 16) ? 0xffff :
+		(1U << analog_write_bits) - 1;
+
+	if (val >= max)
+		return top;
+	return ((unsigned long)val * ((unsigned long)top + 1)) >> analog_write_bits;
+}
+
+// Hardware PWM only works on the pins with timer outputs.
+// These are defined in the appropriate pins_*.c file.  The
+// rest of the pins on PORTB and PORTD get software PWM once
+// softPwmBegin() has been called; otherwise, and for other
+// ports, we default to digital output.
+void analogWrite(uint8_t pin, int value)
+{
+	uint8_t timer = digitalPinToTimer(pin);
+	unsigned int val = value;
+	uint8_t oldSREG;
+
+	if (timer == NOT_ON_TIMER) {
+		if (softpwm_write && softpwm_write(pin, pwm_scale(val, 255)))
+			return;
+		pinMode(pin, OUTPUT);
+		if (val < (1U << (analog_write_bits - 1)))
+			digitalWrite(pin, LOW);
+		else
+			digitalWrite(pin, HIGH);
+		return;
+	}
+
 	// We need to make sure the PWM output is enabled for those pins
-	// that support it, as we turn it off when digitally reading or
-	// writing with them.  Also, make sure the pin is in output mode
-	// for consistenty with Wiring, which doesn't require a pinMode
-	// call for the analog output pins.
-	pinMode(pin, OUTPUT);
+	// that support it, as we turn it off when the pin is set up for
+	// digital use.  Also, make sure the pin is in output mode for
+	// consistenty with Wiring, which doesn't require a pinMode call for
+	// the analog output pins.  Set the direction bit directly, since
+	// pinMode() would disconnect a PWM output that is already running.
+	*portModeRegister(digitalPinToPort(pin)) |= digitalPinToBitMask(pin);
+	pwm_connected |= _BV(timer);
 	
-	if (digitalPinToTimer(pin) == TIMER1A) {
+	if (timer == TIMER1A) {
 		// connect pwm to pin on timer 1, channel A
 		sbi(TCCR1A, COM1A1);
-		// set pwm duty
+		// set pwm duty.  the hardware double buffers OCR1A and takes the
+		// new value at the end of a period, so there's no glitch; the
+		// two byte write just has to be kept in one piece.
+		val = pwm_scale(val, timer1_top);
+		oldSREG = SREG;
+		cli();
 		OCR1A = val;
-	} else if (digitalPinToTimer(pin) == TIMER1B) {
+		SREG = oldSREG;
+	} else if (timer == TIMER1B) {
 		// connect pwm to pin on timer 1, channel B
 		sbi(TCCR1A, COM1B1);
 		// set pwm duty
+		val = pwm_scale(val, timer1_top);
+		oldSREG = SREG;
+		cli();
 		OCR1B = val;
-	} else if (digitalPinToTimer(pin) == TIMER0A) {
+		SREG = oldSREG;
+	} else if (timer == TIMER0A) {
 		// connect pwm to pin on timer 0, channel A
 		sbi(TCCR0A, COM0A1);
 		// set pwm duty
-		OCR0A = val;	
-	} else if (digitalPinToTimer(pin) == TIMER2A) {
+		OCR0A = pwm_scale(val, 255);	
+	} else if (timer == TIMER2A) {
 		// connect pwm to pin on timer 2, channel A
 		sbi(TCCR2A, COM2A1);
 		// set pwm duty
-		OCR2A = val;	
-	} else if (val < 128)
-		digitalWrite(pin, LOW);
-	else
-		digitalWrite(pin, HIGH);
+		OCR2A = pwm_scale(val, 255);	
+	}
 }
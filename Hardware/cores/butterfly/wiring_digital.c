@@ -25,6 +25,25 @@
 #include "wiring_private.h"
 #include "pins_arduino.h"
 
+// Bit n is set while the PWM output of timer channel n (TIMER0A, TIMER1A,
+// ...) is connected to its pin.  analogWrite() sets the bit and pinMode()
+// clears it, so the digital read and write paths can skip the timer lookup
+// entirely while no PWM is running.
+uint8_t pwm_connected = 0;
+
+// Disconnecting the PWM is the rare case now, so this is no longer forced
+// inline into every caller.
+static void turnOffPWM(uint8_t timer)
+{
+	if (timer == TIMER1A) cbi(TCCR1A, COM1A1);
+	if (timer == TIMER1B) cbi(TCCR1A, COM1B1);
+
+	if (timer == TIMER0A) cbi(TCCR0A, COM0A1);
+	if (timer == TIMER2A) cbi(TCCR2A, COM2A1);
+
+	pwm_connected &= ~_BV(timer);
+}
+
 void pinMode(uint8_t pin, uint8_t mode)
 {
 	uint8_t bit = digitalPinToBitMask(pin);
@@ -33,6 +52,12 @@ void pinMode(uint8_t pin, uint8_t mode)
 
 	if (port == NOT_A_PIN) return;
 
+	// A pin being set up for digital use is no longer driven by PWM.
+	if (pwm_connected) {
+		uint8_t timer = digitalPinToTimer(pin);
+		if (pwm_connected & _BV(timer)) turnOffPWM(timer);
+	}
+
 	// JWS: can I let the optimizer do this?
 	reg = portModeRegister(port);
 
@@ -40,35 +65,20 @@ void pinMode(uint8_t pin, uint8_t mode)
 	else *reg |= bit;
 }
 
-// Forcing this inline keeps the callers from having to push their own stuff
-// on the stack. It is a good performance win and only takes 1 more byte per
-// user than calling. (It will take more bytes on the 168.)
-//
-// But shouldn't this be moved into pinMode? Seems silly to check and do on
-// each digitalread or write.
-//
-static inline void turnOffPWM(uint8_t timer) __attribute__ ((always_inline));
-static inline void turnOffPWM(uint8_t timer)
-{
-	if (timer == TIMER1A) cbi(TCCR1A, COM1A1);
-	if (timer == TIMER1B) cbi(TCCR1A, COM1B1);
-
-	if (timer == TIMER0A) cbi(TCCR0A, COM0A1);
-	if (timer == TIMER2A) cbi(TCCR2A, COM2A1);
-}
-
 void digitalWrite(uint8_t pin, uint8_t val)
 {
-	uint8_t timer = digitalPinToTimer(pin);
 	uint8_t bit = digitalPinToBitMask(pin);
 	uint8_t port = digitalPinToPort(pin);
 	volatile uint8_t *out;
 
 	if (port == NOT_A_PIN) return;
 
-	// If the pin that support PWM output, we need to turn it off
-	// before doing a digital write.
-	if (timer != NOT_ON_TIMER) turnOffPWM(timer);
+	// If the pin is outputting PWM, we need to turn it off before doing
+	// a digital write.  Only look up the timer when some PWM is running.
+	if (pwm_connected) {
+		uint8_t timer = digitalPinToTimer(pin);
+		if (pwm_connected & _BV(timer)) turnOffPWM(timer);
+	}
 
 	out = portOutputRegister(port);
 
@@ -78,16 +88,57 @@ void digitalWrite(uint8_t pin, uint8_t val)
 
 int digitalRead(uint8_t pin)
 {
-	uint8_t timer = digitalPinToTimer(pin);
 	uint8_t bit = digitalPinToBitMask(pin);
 	uint8_t port = digitalPinToPort(pin);
 
 	if (port == NOT_A_PIN) return LOW;
 
-	// If the pin that support PWM output, we need to turn it off
-	// before getting a digital reading.
-	if (timer != NOT_ON_TIMER) turnOffPWM(timer);
-
+	// The input register reflects the pin whether or not PWM is driving
+	// it, so there's no need to disconnect the timer to read it.
 	if (*portInputRegister(port) & bit) return HIGH;
 	return LOW;
 }
+
+// The port functions work on any subset of the pins of one port (PBPORT,
+// PDPORT or PFPORT) at once, e.g. for driving a parallel bus on the PORTD
+// pads.  Each bit set in mask selects a pin.  The update is a single
+// read-modify-write with interrupts off, so an ISR touching other pins of
+// the same port can't have its change lost.  PWM outputs on the port are
+// left connected.
+void portMode(uint8_t port, uint8_t mask, uint8_t mode)
+{
+	volatile uint8_t *reg;
+	uint8_t oldSREG;
+
+	if (port < PBPORT || port > PFPORT) return;
+
+	reg = portModeRegister(port);
+
+	oldSREG = SREG;
+	cli();
+	if (mode == INPUT) *reg &= ~mask;
+	else *reg |= mask;
+	SREG = oldSREG;
+}
+
+void portWrite(uint8_t port, uint8_t mask, uint8_t value)
+{
+	volatile uint8_t *out;
+	uint8_t oldSREG;
+
+	if (port < PBPORT || port > PFPORT) return;
+
+	out = portOutputRegister(port);
+
+	oldSREG = SREG;
+	cli();
+	*out = (*out & ~mask) | (value & mask);
+	SREG = oldSREG;
+}
+
+uint8_t portRead(uint8_t port)
+{
+	if (port < PBPORT || port > PFPORT) return 0;
+
+	return *portInputRegister(port);
+}
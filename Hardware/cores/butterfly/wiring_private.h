@@ -51,6 +51,34 @@ extern "C"{
 
 typedef void (*voidFuncPtr)(void);
 
+// The reference selected with analogReference(); see wiring_analog.c
+extern uint8_t analog_reference;
+
+// Catches millis() up after timer0 has been stopped; see wiring.c
+void timer0_skip(unsigned int cycles);
+
+// Lets the timer 0 overflow handler end a tone(); see wiring_tone.c
+extern volatile uint8_t tone_timed;
+extern volatile unsigned long tone_end;
+void tone_expire(void);
+
+// Lets the ADC noise reduction sleep stay out of the way of serial output;
+// see wiring_serial.c
+uint8_t serial_tx_busy(void);
+
+// Set by softPwmBegin() so that analogWrite() can hand pins without a PWM
+// output to wiring_softpwm.c without always linking it in
+extern uint8_t (*softpwm_write)(uint8_t, uint8_t);
+
+// Timer channels (1 << TIMER0A etc.) whose PWM output is connected; see
+// wiring_digital.c
+extern uint8_t pwm_connected;
+
+// Sets up timer 1 in one go, so that ICR1 and the compare values stick
+// whatever mode it is coming from; see wiring_analog.c
+void timer1_load(uint8_t tccr1a, uint8_t tccr1b, uint16_t icr1,
+	uint16_t ocr1a, uint16_t ocr1b);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -22,34 +22,51 @@
   $Id: wiring.c 248 2007-02-03 15:36:30Z mellis $
 */
 
+#include <string.h>
+
 #include "wiring_private.h"
 
-// Define constants and variables for buffering incoming serial data.  We're
-// using a ring buffer (I think), in which rx_buffer_head is the index of the
-// location to which to write the next incoming character and rx_buffer_tail
-// is the index of the location from which to read.
-#define RX_BUFFER_SIZE 128
+// Incoming data is buffered by the code in wiring_serial_rx.cpp, which a
+// sketch can replace with a buffer of another size; see HardwareSerial.h.
+
+// Outgoing data is buffered in a ring and sent from the data register
+// empty interrupt, so serialWrite() only has to wait when the buffer is
+// full.  The indices are single bytes, so each side can read the other's
+// without turning interrupts off.
+#define TX_BUFFER_SIZE 64
+
+static unsigned char tx_buffer[TX_BUFFER_SIZE];
 
-unsigned char rx_buffer[RX_BUFFER_SIZE];
+static volatile uint8_t tx_buffer_head = 0;
+static volatile uint8_t tx_buffer_tail = 0;
 
-int rx_buffer_head = 0;
-int rx_buffer_tail = 0;
+// TXC is cleared by writing a one to it.  The receive error flags in UCSRA
+// must be written as zero, so this can't be done with sbi(), which would
+// write back whatever they read.
+#define clearTXC() (UCSRA = (UCSRA & (_BV(U2X) | _BV(MPCM))) | _BV(TXC))
+
+// set once anything has been sent, so serialDrain() knows TXC will come
+static volatile uint8_t tx_written = 0;
 
 void beginSerial(long baud)
 {
-#if F_CPU <= 1000000
-    // For lower clock speeds set U2X for double speed operation
-    // Baud rate error should be kept to +/- 1.5% in this mode 
-    sbi(UCSRA, U2X );    
-	UBRRH = ((F_CPU /  8 + baud / 2) / baud - 1) >> 8;
-	UBRRL = ((F_CPU /  8 + baud / 2) / baud - 1);
-#else
-    // For higher clock speeds clear U2X for normal speed operation 
-    // Baud rate error should be kept to +/- 2% in this mode 
-    cbi(UCSRA, U2X);
-	UBRRH = ((F_CPU / 16 + baud / 2) / baud - 1) >> 8;
-	UBRRL = ((F_CPU / 16 + baud / 2) / baud - 1);
-#endif	
+	if (clockCyclesPerSecond() <= 1000000L) {
+		// For lower clock speeds set U2X for double speed operation
+		// Baud rate error should be kept to +/- 1.5% in this mode 
+		sbi(UCSRA, U2X);
+		UBRRH = ((clockCyclesPerSecond() /  8 + baud / 2) / baud - 1) >> 8;
+		UBRRL = ((clockCyclesPerSecond() /  8 + baud / 2) / baud - 1);
+	} else {
+		// For higher clock speeds clear U2X for normal speed operation 
+		// Baud rate error should be kept to +/- 2% in this mode 
+		cbi(UCSRA, U2X);
+		UBRRH = ((clockCyclesPerSecond() / 16 + baud / 2) / baud - 1) >> 8;
+		UBRRL = ((clockCyclesPerSecond() / 16 + baud / 2) / baud - 1);
+	}
+
+	// start with an empty receive buffer
+	serialFlush();
+
 	// enable rx and tx
 	sbi(UCSRB, RXEN);
 	sbi(UCSRB, TXEN);
@@ -62,51 +79,102 @@ void beginSerial(long baud)
 
 void serialWrite(unsigned char c)
 {
-	while (!(UCSRA & (1 << UDRE)))
-		;
+	uint8_t i;
 
-	UDR = c;
-}
+	tx_written = 1;
 
-int serialAvailable()
-{
-	return (RX_BUFFER_SIZE + rx_buffer_head - rx_buffer_tail) % RX_BUFFER_SIZE;
+	// with nothing queued and the data register free, skip the buffer.
+	// writing TXC clears it, so it next comes on when this byte is out.
+	if (tx_buffer_head == tx_buffer_tail && (UCSRA & (1 << UDRE))) {
+		UDR = c;
+		clearTXC();
+		return;
+	}
+
+	i = (tx_buffer_head + 1) & (TX_BUFFER_SIZE - 1);
+
+	// wait for the interrupt to make room.  if interrupts are off (e.g.
+	// we're called from an ISR) it never will, so send a byte ourselves.
+	while (i == tx_buffer_tail) {
+		if (!(SREG & _BV(SREG_I)) && (UCSRA & (1 << UDRE))) {
+			UDR = tx_buffer[tx_buffer_tail];
+			clearTXC();
+			tx_buffer_tail = (tx_buffer_tail + 1) & (TX_BUFFER_SIZE - 1);
+		}
+	}
+
+	tx_buffer[tx_buffer_head] = c;
+	tx_buffer_head = i;
+
+	sbi(UCSRB, UDRIE);
 }
 
-int serialRead()
+// Queues a run of bytes, copying as much as fits in one go and moving the
+// head once per copy rather than once per byte.
+void serialWriteBuffer(const unsigned char *buffer, unsigned int size)
 {
-	// if the head isn't ahead of the tail, we don't have any characters
-	if (rx_buffer_head == rx_buffer_tail) {
-		return -1;
-	} else {
-		unsigned char c = rx_buffer[rx_buffer_tail];
-		rx_buffer_tail = (rx_buffer_tail + 1) % RX_BUFFER_SIZE;
-		return c;
+	uint8_t head, tail, n;
+
+	while (size) {
+		head = tx_buffer_head;
+		tail = tx_buffer_tail;
+
+		// free space up to the end of the array, keeping one slot empty
+		// so a full buffer can be told from an empty one
+		if (tail > head)
+			n = tail - head - 1;
+		else
+			n = TX_BUFFER_SIZE - head - (tail == 0);
+
+		if (n == 0) {
+			// full: let serialWrite() do the waiting
+			serialWrite(*buffer++);
+			size--;
+			continue;
+		}
+		if (n > size)
+			n = size;
+
+		tx_written = 1;
+		memcpy(tx_buffer + head, buffer, n);
+		tx_buffer_head = (head + n) & (TX_BUFFER_SIZE - 1);
+		sbi(UCSRB, UDRIE);
+
+		buffer += n;
+		size -= n;
 	}
 }
 
-void serialFlush()
+// True while there is output queued or still being shifted out
+uint8_t serial_tx_busy(void)
 {
-	// don't reverse this or there may be problems if the RX interrupt
-	// occurs after reading the value of rx_buffer_head but before writing
-	// the value to rx_buffer_tail; the previous value of rx_buffer_head
-	// may be written to rx_buffer_tail, making it appear as if the buffer
-	// were full, not empty.
-	rx_buffer_head = rx_buffer_tail;
+	return tx_written &&
+		(tx_buffer_head != tx_buffer_tail || !(UCSRA & (1 << TXC)));
 }
 
-SIGNAL(SIG_UART_RECV)
+// Waits until everything written has left the transmitter
+void serialDrain()
 {
-	unsigned char c = UDR;
+	if (!tx_written)
+		return;
 
-	int i = (rx_buffer_head + 1) % RX_BUFFER_SIZE;
+	while (tx_buffer_head != tx_buffer_tail)
+		;
+	while (!(UCSRA & (1 << TXC)))
+		;
+}
 
-	// if we should be storing the received character into the location
-	// just before the tail (meaning that the head would advance to the
-	// current location of the tail), we're about to overflow the buffer
-	// and so we don't write the character or advance the head.
-	if (i != rx_buffer_tail) {
-		rx_buffer[rx_buffer_head] = c;
-		rx_buffer_head = i;
+SIGNAL(SIG_UART_DATA)
+{
+	uint8_t t = tx_buffer_tail;
+
+	if (tx_buffer_head == t) {
+		// nothing left to send
+		cbi(UCSRB, UDRIE);
+		return;
 	}
+
+	UDR = tx_buffer[t];
+	clearTXC();
+	tx_buffer_tail = (t + 1) & (TX_BUFFER_SIZE - 1);
 }
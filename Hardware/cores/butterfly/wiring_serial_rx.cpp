@@ -0,0 +1,25 @@
+/*
+  wiring_serial_rx.cpp - Default serial receive buffer
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "wiring.h"
+#include "HardwareSerial.h"
+
+// Kept in a file of its own so that a sketch using SERIAL_RX_BUFFER()
+// replaces all of it.  If anything else went in here, the linker would
+// pull this file in as well and find two receive interrupts.
+SERIAL_RX_BUFFER(128);
@@ -23,18 +23,139 @@
 */
 
 #include "wiring_private.h"
+#include "pins_arduino.h"
 
-void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, byte val)
+// The names are in parentheses so the fast path macros in wiring.h don't
+// expand here.
+void (shiftOut)(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, byte val)
 {
-	int i;
+	// cache the ports and bits of the pins rather than going through
+	// digitalWrite() three times per bit.
+	volatile uint8_t *dataOut = portOutputRegister(digitalPinToPort(dataPin));
+	volatile uint8_t *clockOut = portOutputRegister(digitalPinToPort(clockPin));
+	uint8_t dataBit = digitalPinToBitMask(dataPin);
+	uint8_t clockBit = digitalPinToBitMask(clockPin);
+	uint8_t i;
+
+	if (digitalPinToPort(dataPin) == NOT_A_PIN ||
+	    digitalPinToPort(clockPin) == NOT_A_PIN)
+		return;
 
 	for (i = 0; i < 8; i++)  {
-		if (bitOrder == LSBFIRST)
-			digitalWrite(dataPin, !!(val & (1 << i)));
-		else	
-			digitalWrite(dataPin, !!(val & (1 << (7 - i))));
-			
-		digitalWrite(clockPin, HIGH);
-		digitalWrite(clockPin, LOW);		
+		uint8_t bit;
+
+		if (bitOrder == LSBFIRST) {
+			bit = val & 0x01;
+			val >>= 1;
+		} else {
+			bit = val & 0x80;
+			val <<= 1;
+		}
+
+		if (bit) *dataOut |= dataBit;
+		else *dataOut &= ~dataBit;
+
+		*clockOut |= clockBit;
+		*clockOut &= ~clockBit;
+	}
+}
+
+uint8_t (shiftIn)(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder)
+{
+	volatile uint8_t *dataIn = portInputRegister(digitalPinToPort(dataPin));
+	volatile uint8_t *clockOut = portOutputRegister(digitalPinToPort(clockPin));
+	uint8_t dataBit = digitalPinToBitMask(dataPin);
+	uint8_t clockBit = digitalPinToBitMask(clockPin);
+	uint8_t val = 0;
+	uint8_t i;
+
+	if (digitalPinToPort(dataPin) == NOT_A_PIN ||
+	    digitalPinToPort(clockPin) == NOT_A_PIN)
+		return 0;
+
+	for (i = 0; i < 8; i++) {
+		*clockOut |= clockBit;
+
+		if (bitOrder == LSBFIRST) {
+			val >>= 1;
+			if (*dataIn & dataBit) val |= 0x80;
+		} else {
+			val <<= 1;
+			if (*dataIn & dataBit) val |= 0x01;
+		}
+
+		*clockOut &= ~clockBit;
 	}
+
+	return val;
+}
+
+/* Shifts a byte out on MOSI (PB2) and in on MISO (PB3) through the hardware
+ * SPI, clocking SCK (PB1) at F_CPU/2.  If the SPI isn't running yet it is set
+ * up as master, mode 0; if the DataFlash library already started it, its
+ * mode 3 is kept, which latches on the same rising edge.  /SS (PB0) is the
+ * DataFlash chip select, so it is held high as an output. */
+uint8_t spiShift(uint8_t bitOrder, uint8_t val)
+{
+	uint8_t spcr;
+
+	if (!(SPCR & _BV(SPE))) {
+		PORTB |= _BV(0);
+		DDRB |= _BV(2) | _BV(1) | _BV(0);
+		SPSR = _BV(SPI2X);
+		SPCR = _BV(SPE) | _BV(MSTR);
+	}
+
+	// the bit order is only changed for this byte; the DataFlash library
+	// expects the SPI as it left it
+	spcr = SPCR;
+	if (bitOrder == LSBFIRST) SPCR = spcr | _BV(DORD);
+	else SPCR = spcr & ~_BV(DORD);
+
+	SPDR = val;
+	while (!(SPSR & _BV(SPIF)))
+		;
+
+	SPCR = spcr;
+	return SPDR;
+}
+
+/* Shifts a byte out on DO (PE6) and in on DI (PE5) through the USI in
+ * three-wire mode, strobing the clock on USCK (PE4) from software.  The USI
+ * only shifts MSB first, so LSBFIRST bytes are reversed on the way in and
+ * out. */
+uint8_t usiShift(uint8_t bitOrder, uint8_t val)
+{
+	// each write toggles USCK; writes with USICLK set also shift the
+	// register, so sixteen writes clock one byte.
+	const uint8_t lo = _BV(USIWM0) | _BV(USITC);
+	const uint8_t hi = _BV(USIWM0) | _BV(USITC) | _BV(USICLK);
+
+	if (bitOrder == LSBFIRST) {
+		val = ((val & 0xF0) >> 4) | ((val & 0x0F) << 4);
+		val = ((val & 0xCC) >> 2) | ((val & 0x33) << 2);
+		val = ((val & 0xAA) >> 1) | ((val & 0x55) << 1);
+	}
+
+	DDRE |= _BV(4) | _BV(6);
+	DDRE &= ~_BV(5);
+
+	USIDR = val;
+	USICR = lo; USICR = hi;
+	USICR = lo; USICR = hi;
+	USICR = lo; USICR = hi;
+	USICR = lo; USICR = hi;
+	USICR = lo; USICR = hi;
+	USICR = lo; USICR = hi;
+	USICR = lo; USICR = hi;
+	USICR = lo; USICR = hi;
+	val = USIDR;
+
+	if (bitOrder == LSBFIRST) {
+		val = ((val & 0xF0) >> 4) | ((val & 0x0F) << 4);
+		val = ((val & 0xCC) >> 2) | ((val & 0x33) << 2);
+		val = ((val & 0xAA) >> 1) | ((val & 0x55) << 1);
+	}
+
+	return val;
 }
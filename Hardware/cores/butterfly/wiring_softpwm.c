@@ -0,0 +1,265 @@
+/*
+  wiring_softpwm.c - PWM in software on any PORTB or PORTD pin
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include "wiring_private.h"
+#include "pins_arduino.h"
+
+/* Each period starts with every channel that has a duty above zero
+ * switched on.  Channels are then switched off in order of duty, and
+ * channels with the same duty go off together, so the compare interrupt
+ * only fires once per distinct duty value.  Each firing writes whole port
+ * masks, no matter how many pins are involved.
+ *
+ * The edge list is rebuilt by softPwmWrite() into a second schedule and
+ * swapped in by the interrupt at the start of a period, so a period never
+ * runs half of one list and half of another. */
+
+#define SOFTPWM_CHANNELS 16
+
+// Edges closer than this many timer ticks to now are done at once rather
+// than left to a compare match that the counter may already have passed
+#define SOFTPWM_SLACK 4
+
+struct softpwm_edge {
+	uint8_t duty;
+	uint8_t clear_b;
+	uint8_t clear_d;
+};
+
+struct softpwm_schedule {
+	uint8_t all_b;
+	uint8_t all_d;
+	uint8_t on_b;
+	uint8_t on_d;
+	uint8_t count;
+	struct softpwm_edge edge[SOFTPWM_CHANNELS];
+};
+
+static struct softpwm_schedule softpwm_schedule[2];
+static volatile uint8_t softpwm_active = 0;
+static volatile uint8_t softpwm_pending = 0;
+static uint8_t softpwm_next;
+static uint8_t softpwm_step;      // timer ticks per duty step
+
+static uint8_t softpwm_channels = 0;
+static uint8_t softpwm_port[SOFTPWM_CHANNELS];
+static uint8_t softpwm_mask[SOFTPWM_CHANNELS];
+static uint8_t softpwm_duty[SOFTPWM_CHANNELS];
+
+static uint8_t softpwm_saved_tccr1a, softpwm_saved_tccr1b, softpwm_saved_pwm;
+static uint16_t softpwm_saved_ocr1a, softpwm_saved_ocr1b, softpwm_saved_icr1;
+
+SIGNAL(SIG_OUTPUT_COMPARE1A)
+{
+	struct softpwm_schedule *s;
+	uint8_t i = softpwm_next;
+	unsigned int t;
+
+	if (i == 0xff) {
+		// start of a period; take up a new schedule if there is one
+		if (softpwm_pending) {
+			softpwm_active ^= 1;
+			softpwm_pending = 0;
+		}
+		s = &softpwm_schedule[softpwm_active];
+		// clearing every channel first turns off any pin that was left
+		// on at full duty by the last schedule
+		PORTB = (PORTB & ~s->all_b) | s->on_b;
+		PORTD = (PORTD & ~s->all_d) | s->on_d;
+		i = 0;
+	} else {
+		s = &softpwm_schedule[softpwm_active];
+	}
+
+	while (i < s->count) {
+		t = (unsigned int)s->edge[i].duty * softpwm_step;
+		if (t > TCNT1 + SOFTPWM_SLACK) {
+			OCR1A = t;
+			softpwm_next = i;
+			return;
+		}
+		PORTB &= ~s->edge[i].clear_b;
+		PORTD &= ~s->edge[i].clear_d;
+		i++;
+	}
+
+	// nothing more until the counter comes back round to zero
+	OCR1A = 0;
+	softpwm_next = 0xff;
+}
+
+// Sorts the channels into a new edge list and hands it to the interrupt
+static void softpwm_schedule_build(void)
+{
+	struct softpwm_schedule *s;
+	uint8_t c, i, j, duty, b, d;
+
+	// while nothing is pending the interrupt won't swap, so the back
+	// schedule is ours to write
+	softpwm_pending = 0;
+	s = &softpwm_schedule[softpwm_active ^ 1];
+	s->all_b = s->all_d = 0;
+	s->on_b = s->on_d = 0;
+	s->count = 0;
+
+	for (c = 0; c < softpwm_channels; c++) {
+		b = (softpwm_port[c] == PBPORT) ? softpwm_mask[c] : 0;
+		d = (softpwm_port[c] == PDPORT) ? softpwm_mask[c] : 0;
+		s->all_b |= b;
+		s->all_d |= d;
+
+		duty = softpwm_duty[c];
+		if (duty == 0)
+			continue;
+
+		s->on_b |= b;
+		s->on_d |= d;
+
+		// full duty never goes off
+		if (duty == 255)
+			continue;
+
+		// insertion sort by duty, merging channels with the same duty
+		for (i = 0; i < s->count && s->edge[i].duty < duty; i++)
+			;
+		if (i < s->count && s->edge[i].duty == duty) {
+			s->edge[i].clear_b |= b;
+			s->edge[i].clear_d |= d;
+			continue;
+		}
+		for (j = s->count; j > i; j--)
+			s->edge[j] = s->edge[j - 1];
+		s->edge[i].duty = duty;
+		s->edge[i].clear_b = b;
+		s->edge[i].clear_d = d;
+		s->count++;
+	}
+
+	softpwm_pending = 1;
+}
+
+/* Sets the duty (0 to 255) of a software PWM pin, adding it as a channel
+ * the first time.  Returns 0 if the pin isn't on PORTB or PORTD, all the
+ * channels are taken, or softPwmBegin() hasn't been called. */
+uint8_t softPwmWrite(uint8_t pin, uint8_t duty)
+{
+	uint8_t port = digitalPinToPort(pin);
+	uint8_t mask = digitalPinToBitMask(pin);
+	uint8_t c;
+
+	if (!softpwm_write || (port != PBPORT && port != PDPORT))
+		return 0;
+
+	for (c = 0; c < softpwm_channels; c++)
+		if (softpwm_port[c] == port && softpwm_mask[c] == mask)
+			break;
+
+	if (c == softpwm_channels) {
+		if (c == SOFTPWM_CHANNELS)
+			return 0;
+		softpwm_port[c] = port;
+		softpwm_mask[c] = mask;
+		softpwm_channels++;
+		*portOutputRegister(port) &= ~mask;
+		*portModeRegister(port) |= mask;
+	} else if (softpwm_duty[c] == duty) {
+		return 1;
+	}
+
+	softpwm_duty[c] = duty;
+	softpwm_schedule_build();
+	return 1;
+}
+
+/* Takes over timer 1 to run software PWM at about the given frequency,
+ * with 256 steps per period.  From then on analogWrite() drives PORTB and
+ * PORTD pins without a PWM output this way too.  Timer 1 is in CTC mode
+ * with ICR1 as top, so OCR1A can be moved about within a period; PWM on
+ * the timer 1 pins stops until softPwmEnd(), which puts its setup and
+ * duty cycles back. */
+void softPwmBegin(unsigned int frequency)
+{
+	unsigned long step = clockCyclesPerSecond() / (8UL * 256UL * frequency);
+	uint8_t oldSREG;
+
+	if (step < 1)
+		step = 1;
+	if (step > 255)
+		step = 255;
+
+	oldSREG = SREG;
+	cli();
+
+	if (!softpwm_write) {
+		softpwm_saved_tccr1a = TCCR1A;
+		softpwm_saved_tccr1b = TCCR1B;
+		softpwm_saved_ocr1a = OCR1A;
+		softpwm_saved_ocr1b = OCR1B;
+		softpwm_saved_icr1 = ICR1;
+		softpwm_saved_pwm = pwm_connected & (_BV(TIMER1A) | _BV(TIMER1B));
+	}
+
+	softpwm_step = step;
+	softpwm_next = 0xff;
+	softpwm_pending = 0;
+	softpwm_schedule[softpwm_active].count = 0;
+	softpwm_schedule[softpwm_active].all_b = 0;
+	softpwm_schedule[softpwm_active].all_d = 0;
+	softpwm_schedule[softpwm_active].on_b = 0;
+	softpwm_schedule[softpwm_active].on_d = 0;
+
+	// CTC with ICR1 as top (WGM 12), clock / 8
+	timer1_load(0, _BV(WGM13) | _BV(WGM12) | _BV(CS11), 256U * step - 1, 0, 0);
+	// start past zero, so the first period begins when the count comes round
+	TCNT1 = 1;
+	TIFR1 = _BV(OCF1A);
+	TIMSK1 |= _BV(OCIE1A);
+
+	// the timer 1 pins aren't driven by PWM now
+	pwm_connected &= ~(_BV(TIMER1A) | _BV(TIMER1B));
+
+	softpwm_write = softPwmWrite;
+	SREG = oldSREG;
+
+	// pick up channels left over from before
+	softpwm_schedule_build();
+}
+
+void softPwmEnd(void)
+{
+	uint8_t oldSREG = SREG;
+	uint8_t c;
+
+	if (!softpwm_write)
+		return;
+
+	cli();
+	TIMSK1 &= ~_BV(OCIE1A);
+	// put the timer back as it was, restarting from the bottom so no
+	// period overshoots the restored top
+	timer1_load(softpwm_saved_tccr1a, softpwm_saved_tccr1b,
+		softpwm_saved_icr1, softpwm_saved_ocr1a, softpwm_saved_ocr1b);
+	pwm_connected |= softpwm_saved_pwm;
+	softpwm_write = 0;
+	SREG = oldSREG;
+
+	for (c = 0; c < softpwm_channels; c++)
+		*portOutputRegister(softpwm_port[c]) &= ~softpwm_mask[c];
+	softpwm_channels = 0;
+}
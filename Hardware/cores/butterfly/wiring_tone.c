@@ -0,0 +1,128 @@
+/*
+  wiring_tone.c - tone() and noTone() on the timer 1 outputs
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include "wiring_private.h"
+#include "pins_arduino.h"
+
+// Checked by the timer 0 overflow handler in wiring.c, which calls
+// tone_expire() once millis() reaches tone_end.
+volatile uint8_t tone_timed = 0;
+volatile unsigned long tone_end;
+
+static uint8_t tone_pin = 0xff;
+static uint8_t tone_saved_tccr1a, tone_saved_tccr1b, tone_saved_pwm;
+static uint16_t tone_saved_ocr1a, tone_saved_ocr1b, tone_saved_icr1;
+
+static const uint16_t tone_prescale[] = { 1, 8, 64, 256, 1024 };
+
+/* Plays a square wave of the given frequency on SPEAKER (OC1A) or JOYA
+ * (OC1B), using timer 1 in CTC mode to toggle the pin in hardware.  If
+ * duration (in milliseconds) is non-zero the tone stops by itself;
+ * otherwise it plays until noTone().  Timer 1 is taken over while the tone
+ * plays, so PWM on those pins stops, and its previous setup, duty cycles
+ * included, is put back afterwards.  Other pins are ignored. */
+void tone(uint8_t pin, unsigned int frequency, unsigned long duration)
+{
+	uint8_t timer = digitalPinToTimer(pin);
+	unsigned long ocr = 0;
+	uint8_t cs;
+	uint8_t oldSREG;
+
+	if (timer != TIMER1A && timer != TIMER1B)
+		return;
+	if (frequency == 0) {
+		noTone(pin);
+		return;
+	}
+
+	// each toggle is half a period; use the finest prescale that fits
+	for (cs = 0; cs < 5; cs++) {
+		ocr = clockCyclesPerSecond() / (2UL * tone_prescale[cs] * frequency);
+		if (ocr <= 65536UL)
+			break;
+	}
+	if (cs == 5)
+		ocr = 65536UL;
+	if (ocr)
+		ocr--;
+
+	oldSREG = SREG;
+	cli();
+
+	if (tone_pin == 0xff) {
+		tone_saved_tccr1a = TCCR1A;
+		tone_saved_tccr1b = TCCR1B;
+		tone_saved_ocr1a = OCR1A;
+		tone_saved_ocr1b = OCR1B;
+		tone_saved_icr1 = ICR1;
+		tone_saved_pwm = pwm_connected & (_BV(TIMER1A) | _BV(TIMER1B));
+	}
+	tone_pin = pin;
+
+	*portModeRegister(digitalPinToPort(pin)) |= digitalPinToBitMask(pin);
+
+	// CTC with OCR1A as top (WGM12); OC1B toggles at a count of zero,
+	// so both outputs run at the same frequency
+	TCCR1B = 0;
+	TCCR1A = (timer == TIMER1A) ? _BV(COM1A0) : _BV(COM1B0);
+	OCR1A = ocr;
+	OCR1B = 0;
+	TCNT1 = 0;
+	TCCR1B = _BV(WGM12) | (cs + 1);
+
+	// neither channel is running PWM now
+	pwm_connected &= ~(_BV(TIMER1A) | _BV(TIMER1B));
+
+	if (duration) {
+		tone_end = millis() + duration;
+		tone_timed = 1;
+	} else {
+		tone_timed = 0;
+	}
+
+	SREG = oldSREG;
+}
+
+void noTone(uint8_t pin)
+{
+	uint8_t oldSREG = SREG;
+
+	cli();
+	if (tone_pin != 0xff && (pin == tone_pin || pin == 0xff)) {
+		tone_timed = 0;
+
+		// leave the pin low rather than wherever the last toggle left it
+		TCCR1A = 0;
+		*portOutputRegister(digitalPinToPort(tone_pin)) &=
+			~digitalPinToBitMask(tone_pin);
+
+		// put the PWM back as it was, restarting from the bottom so no
+		// period overshoots the restored top
+		timer1_load(tone_saved_tccr1a, tone_saved_tccr1b, tone_saved_icr1,
+			tone_saved_ocr1a, tone_saved_ocr1b);
+		pwm_connected |= tone_saved_pwm;
+		tone_pin = 0xff;
+	}
+	SREG = oldSREG;
+}
+
+void tone_expire(void)
+{
+	noTone(0xff);
+}
@@ -95,6 +95,8 @@ static volatile uint8_t  ClearNext				= false;
 
 volatile uint8_t  BF_LCD::ScrollFlags;
 
+static void LCD_EndText(uint8_t LoadB);
+
 // ======================================================================================
 
 /*
@@ -132,29 +134,13 @@ void BF_LCD::init(void)
 }
 
 /*
-NAME:      | putS_f
-PURPOSE:   | Displays a string from flash onto the Butterfly's LCD
-ARGUMENTS: | Pointer to the start of the flash string
-RETURNS:   | None
-*/
-void BF_LCD::prints_f(const char *FlashData)
-{
-	/* Rather than create a new buffer here (wasting RAM), the TextBuffer global
-	is re-used as a temp buffer. Once the ASCII data is loaded in to TextBuffer,
-	LCD_puts is called with it to post-process it into the correct format for the
-	LCD interrupt.                                                                */
-
-	strcpy_P((char*)&TextBuffer[0], FlashData);
-	prints((char*)&TextBuffer[0]);
-}
-
-/*
-NAME:      | prints
-PURPOSE:   | Displays a string from SRAM onto the Butterfly's LCD
-ARGUMENTS: | Pointer to the start of the SRAM string
+NAME:      | LCD_LoadText (static)
+PURPOSE:   | Converts a string from SRAM or flash into the format used by the
+			 LCD interrupt and starts it displaying
+ARGUMENTS: | Pointer to the start of the string, true if it is in flash
 RETURNS:   | None
 */
-void BF_LCD::prints(const char Data[])//const char *Data)
+static void LCD_LoadText(const char *Data, const uint8_t InFlash)
 {
 	ClearNext 			= false;  // prints always clears the current output
 	uint8_t LoadB       = 0;
@@ -162,7 +148,8 @@ void BF_LCD::prints(const char Data[])//const char *Data)
 	
 	do
 	{
-		CurrByte = *(Data++);
+		CurrByte = (InFlash ? pgm_read_byte(Data) : *Data);
+		Data++;
 		
 		switch (CurrByte)
 		{
@@ -179,37 +166,54 @@ void BF_LCD::prints(const char Data[])//const char *Data)
 	}
 	while (CurrByte && (LoadB < LCD_TEXTBUFFER_SIZE));
 
-	ScrollFlags = ((LoadB > LCD_DISPLAY_SIZE)? LCD_FLAG_SCROLL : 0x00);
-
-	for (uint8_t Nulls = 0; Nulls < 7; Nulls++)
-	TextBuffer[LoadB++] = LCD_SPACE_OR_INVALID_CHAR;  // Load in nulls to ensure that when scrolling, the display clears before wrapping
-
-	TextBuffer[LoadB] = 0x00;                           // Null-terminate string
+	LCD_EndText(LoadB);
+}
 
-	StrStart      = 0;
-	StrEnd        = LoadB;
-	ScrollCount   = LCD_SCROLLCOUNT_DEFAULT + LCD_DELAYCOUNT_DEFAULT;
-	UpdateDisplay = true;
+/*
+NAME:      | putS_f
+PURPOSE:   | Displays a string from flash onto the Butterfly's LCD
+ARGUMENTS: | Pointer to the start of the flash string
+RETURNS:   | None
+*/
+void BF_LCD::prints_f(const char *FlashData)
+{
+	// The characters are converted straight out of flash, so neither the
+	// string nor a copy of it needs any RAM.
+	LCD_LoadText(FlashData, true);
 }
 
 /*
-NAME:      | appendc
-PURPOSE:   | Appends a character from SRAM onto the Butterfly's LCD
-			 This is primarly used for interfacing to the Write 
-			 function from the print class.
-ARGUMENTS: | The charater to append
+NAME:      | prints
+PURPOSE:   | Displays a string from flash, wrapped in F(), onto the Butterfly's LCD
+ARGUMENTS: | Pointer to the start of the flash string
 RETURNS:   | None
 */
-void BF_LCD::appendc(char Data)
+void BF_LCD::prints(const __FlashStringHelper *FlashData)
 {
-	// ClearNext indicates that a println was used and so new lines should first clear old lines.
-	if (ClearNext)
-		clear();
+	LCD_LoadText((const char*)FlashData, true);
+}
 
-	uint8_t LoadB = StrEnd - LCD_DISPLAY_SIZE -1;
+/*
+NAME:      | prints
+PURPOSE:   | Displays a string from SRAM onto the Butterfly's LCD
+ARGUMENTS: | Pointer to the start of the SRAM string
+RETURNS:   | None
+*/
+void BF_LCD::prints(const char Data[])//const char *Data)
+{
+	LCD_LoadText(Data, false);
+}
 
-	// If no more room is available in the buffer, shift
-	// the contents back and drop the first character.
+/*
+NAME:      | LCD_LoadChar (static)
+PURPOSE:   | Converts a character into the text buffer after the current text
+			 If no more room is available in the buffer, the contents are 
+			 shifted back and the first character dropped.
+ARGUMENTS: | Index of the end of the current text, character to load
+RETURNS:   | Index of the new end of the text
+*/
+static uint8_t LCD_LoadChar(uint8_t LoadB, char Data)
+{
 	if (LoadB == LCD_TEXTBUFFER_SIZE){
 		for (uint8_t i = 0; i < LCD_TEXTBUFFER_SIZE-1; i++)
 			TextBuffer[i] = TextBuffer[i+1];
@@ -232,7 +236,19 @@ void BF_LCD::appendc(char Data)
 		TextBuffer[LoadB++] = LCD_SPACE_OR_INVALID_CHAR;
 	}
 
-	ScrollFlags = ((LoadB > LCD_DISPLAY_SIZE)? LCD_FLAG_SCROLL : 0x00);
+	return LoadB;
+}
+
+/*
+NAME:      | LCD_EndText (static)
+PURPOSE:   | Pads and terminates the text loaded by LCD_LoadChar and
+			 restarts the display and scrolling from the beginning
+ARGUMENTS: | Index of the end of the text
+RETURNS:   | None
+*/
+static void LCD_EndText(uint8_t LoadB)
+{
+	BF_LCD::ScrollFlags = ((LoadB > LCD_DISPLAY_SIZE)? LCD_FLAG_SCROLL : 0x00);
 
 	for (uint8_t Nulls = 0; Nulls < 7; Nulls++)
 		TextBuffer[LoadB++] = LCD_SPACE_OR_INVALID_CHAR;  // Load in nulls to ensure that when scrolling, the display clears before wrapping
@@ -245,6 +261,23 @@ void BF_LCD::appendc(char Data)
 	UpdateDisplay = true;
 }
 
+/*
+NAME:      | appendc
+PURPOSE:   | Appends a character from SRAM onto the Butterfly's LCD
+			 This is primarly used for interfacing to the Write 
+			 function from the print class.
+ARGUMENTS: | The charater to append
+RETURNS:   | None
+*/
+void BF_LCD::appendc(char Data)
+{
+	// ClearNext indicates that a println was used and so new lines should first clear old lines.
+	if (ClearNext)
+		clear();
+
+	LCD_EndText(LCD_LoadChar(StrEnd - LCD_DISPLAY_SIZE - 1, Data));
+}
+
 
 /*
 NAME:      | clear
@@ -290,6 +323,34 @@ void BF_LCD::write(uint8_t b)
 	appendc((char)b);
 } 
 
+/*
+NAME:      | write
+PURPOSE:   | Routine to print a run of characters to the LCD
+			 The whole run is converted before the text is padded
+			 and the scrolling restarted, rather than once per character.
+ARGUMENTS: | Pointer to the characters, number of characters
+RETURNS:   | None
+*/
+void BF_LCD::write(const uint8_t *buffer, size_t size)
+{
+	uint8_t LoadB = StrEnd - LCD_DISPLAY_SIZE - 1;
+
+	if (!size)
+		return;
+
+	while (size--)
+	{
+		if (ClearNext)
+		{
+			clear();
+			LoadB = 0;
+		}
+		LoadB = LCD_LoadChar(LoadB, (char)*buffer++);
+	}
+
+	LCD_EndText(LoadB);
+}
+
 //void BF_LCD::println(void)
 //{
 //  ClearNext = true;
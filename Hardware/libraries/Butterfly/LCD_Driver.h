@@ -44,6 +44,7 @@ public:
 	BF_LCD( void );
 	void prints_f(const char *FlashData);
 	void prints(const char Data[]);//const char *Data);
+	void prints(const __FlashStringHelper *FlashData);
 	void appendc(char Data);
 	void clear(void);
 	void init(void);
@@ -54,6 +55,7 @@ public:
 	#endif
 	
 	virtual void write(uint8_t);
+	virtual void write(const uint8_t *buffer, size_t size);
 };
 
 extern BF_LCD LCD;
@@ -0,0 +1,419 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <wiring.h>
+#include <wiring_private.h>
+#include <pins_arduino.h>
+
+#include "audio.h"
+#include "dataflash.h"
+
+// An instance of the audio engine
+BF_Audio Audio = BF_Audio();
+
+const prog_int8_t AudioSine[256] PROGMEM = {
+	   0,    3,    6,    9,   12,   16,   19,   22,   25,   28,   31,   34,   37,   40,   43,   46,
+	  49,   51,   54,   57,   60,   63,   65,   68,   71,   73,   76,   78,   81,   83,   85,   88,
+	  90,   92,   94,   96,   98,  100,  102,  104,  106,  107,  109,  111,  112,  113,  115,  116,
+	 117,  118,  120,  121,  122,  122,  123,  124,  125,  125,  126,  126,  126,  127,  127,  127,
+	 127,  127,  127,  127,  126,  126,  126,  125,  125,  124,  123,  122,  122,  121,  120,  118,
+	 117,  116,  115,  113,  112,  111,  109,  107,  106,  104,  102,  100,   98,   96,   94,   92,
+	  90,   88,   85,   83,   81,   78,   76,   73,   71,   68,   65,   63,   60,   57,   54,   51,
+	  49,   46,   43,   40,   37,   34,   31,   28,   25,   22,   19,   16,   12,    9,    6,    3,
+	   0,   -3,   -6,   -9,  -12,  -16,  -19,  -22,  -25,  -28,  -31,  -34,  -37,  -40,  -43,  -46,
+	 -49,  -51,  -54,  -57,  -60,  -63,  -65,  -68,  -71,  -73,  -76,  -78,  -81,  -83,  -85,  -88,
+	 -90,  -92,  -94,  -96,  -98, -100, -102, -104, -106, -107, -109, -111, -112, -113, -115, -116,
+	-117, -118, -120, -121, -122, -122, -123, -124, -125, -125, -126, -126, -126, -127, -127, -127,
+	-127, -127, -127, -127, -126, -126, -126, -125, -125, -124, -123, -122, -122, -121, -120, -118,
+	-117, -116, -115, -113, -112, -111, -109, -107, -106, -104, -102, -100,  -98,  -96,  -94,  -92,
+	 -90,  -88,  -85,  -83,  -81,  -78,  -76,  -73,  -71,  -68,  -65,  -63,  -60,  -57,  -54,  -51,
+	 -49,  -46,  -43,  -40,  -37,  -34,  -31,  -28,  -25,  -22,  -19,  -16,  -12,   -9,   -6,   -3,
+};
+
+// IMA ADPCM step sizes and index adjustments
+static const prog_uint16_t AdpcmStep[89] PROGMEM = {
+	7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21,
+	23, 25, 28, 31, 34, 37, 41, 45, 50, 55, 60, 66,
+	73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209,
+	230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658,
+	724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+	2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484,
+	7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350,
+	22385, 24623, 27086, 29794, 32767,
+};
+static const prog_int8_t AdpcmIndex[8] PROGMEM = { -1, -1, -1, -1, 2, 4, 6, 8 };
+
+// What the interrupt takes samples from
+#define SOURCE_NONE   0
+#define SOURCE_RING   1
+#define SOURCE_FLASH  2
+#define SOURCE_DDS    3
+
+static volatile uint8_t  Source = SOURCE_NONE;
+static uint8_t  Format;
+static uint8_t  Divider;                   // carrier periods per sample
+static volatile uint8_t  Count;
+static volatile uint8_t  Sample = 0;       // next value for OCR1A
+static volatile uint8_t  Underruns = 0;
+static uint8_t  SavedTCCR1A, SavedTCCR1B, SavedPWM;
+static uint16_t SavedOCR1A, SavedOCR1B, SavedICR1;
+static volatile uint8_t  Running = 0;
+
+// Single producer (write()), single consumer (the ISR) ring, as in the
+// joystick queue. Each side only writes its own index.
+static volatile uint8_t  Ring[AUDIO_BUFFER_SIZE];
+static volatile uint8_t  RingHead = 0;
+static volatile uint8_t  RingTail = 0;
+
+static volatile unsigned long FlashLeft;   // bytes left in the clip
+
+// ADPCM decoder state
+static int16_t  Predicted;
+static uint8_t  StepIndex;
+static uint8_t  Nibbles;                   // second half of the last byte
+static uint8_t  HaveNibble;
+
+// DDS oscillators; a voice with an increment of 0 is off
+static uint16_t Phase[AUDIO_VOICES];
+static volatile uint16_t Increment[AUDIO_VOICES];
+static const prog_int8_t * volatile Wave[AUDIO_VOICES];
+
+static unsigned int SampleRate;
+
+// Returns the next byte of the current source, or -1 if there isn't one
+static int fetch(void)
+{
+	uint8_t b;
+
+	if (Source == SOURCE_RING) {
+		if (RingHead == RingTail)
+			return -1;
+		b = Ring[RingTail];
+		RingTail = (RingTail + 1) & (AUDIO_BUFFER_SIZE - 1);
+		return b;
+	}
+
+	if (FlashLeft == 0) {
+		// end of the clip
+		DataFlash.Deactivate();
+		Source = SOURCE_NONE;
+		return -1;
+	}
+	FlashLeft--;
+	return DataFlash.ReadNextByte();
+}
+
+static uint8_t adpcmDecode(uint8_t n)
+{
+	uint16_t step = pgm_read_word(AdpcmStep + StepIndex);
+	uint16_t diff = step >> 3;
+	int32_t p;
+	int8_t i;
+
+	if (n & 4) diff += step;
+	if (n & 2) diff += step >> 1;
+	if (n & 1) diff += step >> 2;
+
+	p = Predicted;
+	p += (n & 8) ? -(int32_t)diff : (int32_t)diff;
+	if (p > 32767) p = 32767;
+	else if (p < -32768) p = -32768;
+	Predicted = p;
+
+	i = StepIndex + (int8_t)pgm_read_byte(AdpcmIndex + (n & 7));
+	if (i < 0) i = 0;
+	else if (i > 88) i = 88;
+	StepIndex = i;
+
+	return (uint8_t)((Predicted >> 8) + 128);
+}
+
+// Works out the sample after the one just loaded. An underrun holds the
+// last value, which is silent, rather than jumping to the midpoint.
+static inline void nextSample(void)
+{
+	int b;
+
+	if (Source == SOURCE_DDS) {
+		int16_t sum = 0;
+		for (uint8_t v = 0; v < AUDIO_VOICES; v++) {
+			if (Increment[v]) {
+				Phase[v] += Increment[v];
+				sum += (int8_t)pgm_read_byte(Wave[v] + (Phase[v] >> 8));
+			}
+		}
+		Sample = (uint8_t)((sum >> 2) + 128);
+		return;
+	}
+
+	if (Source == SOURCE_NONE)
+		return;
+
+	if (Format == AUDIO_ADPCM4 && HaveNibble) {
+		HaveNibble = 0;
+		Sample = adpcmDecode(Nibbles);
+		return;
+	}
+
+	b = fetch();
+	if (b < 0) {
+		if (Source == SOURCE_RING && Underruns < 255)
+			Underruns++;
+		return;
+	}
+
+	if (Format == AUDIO_ADPCM4) {
+		Nibbles = b >> 4;
+		HaveNibble = 1;
+		Sample = adpcmDecode(b & 0x0F);
+	} else {
+		Sample = b;
+	}
+}
+
+// Fires once per carrier period. The sample is loaded first so it lands
+// at the same point every time; OCR1A is double buffered by the hardware
+// and takes the new value at the top of the count.
+ISR(TIMER1_COMPB_vect)
+{
+	if (--Count)
+		return;
+	Count = Divider;
+
+	OCR1A = Sample;
+	nextSample();
+}
+
+static void startSource(uint8_t source, uint8_t format)
+{
+	uint8_t oldSREG = SREG;
+
+	cli();
+	Format = format;
+	Predicted = 0;
+	StepIndex = 0;
+	HaveNibble = 0;
+	Source = source;
+	SREG = oldSREG;
+}
+
+/*
+NAME:      | begin
+PURPOSE:   | Takes over timer 1 and starts the PWM carrier on SPEAKER
+ARGUMENTS: | sampleRate - samples per second; rounded to a whole division
+           | of the carrier, from 1 up
+RETURNS:   | None
+*/
+void BF_Audio::begin(unsigned int sampleRate)
+{
+	unsigned long carrier = clockCyclesPerSecond() / 256;
+	unsigned long d;
+
+	if (sampleRate < 1) sampleRate = 1;
+	d = (carrier + sampleRate / 2) / sampleRate;
+
+	if (d < 1) d = 1;
+	if (d > 255) d = 255;
+	Divider = d;
+	SampleRate = carrier / d;
+
+	uint8_t oldSREG = SREG;
+	cli();
+	if (!Running) {
+		SavedTCCR1A = TCCR1A;
+		SavedTCCR1B = TCCR1B;
+		SavedOCR1A = OCR1A;
+		SavedOCR1B = OCR1B;
+		SavedICR1 = ICR1;
+		SavedPWM = pwm_connected & (_BV(TIMER1A) | _BV(TIMER1B));
+		Running = 1;
+	}
+	Source = SOURCE_NONE;
+	Sample = 0;
+	Count = Divider;
+
+	// fast PWM, 8 bit (WGM 5), no prescaling, non-inverting on OC1A
+	TCCR1B = 0;
+	TCCR1A = _BV(COM1A1) | _BV(WGM10);
+	OCR1A = 0;
+	OCR1B = 0;
+	TCNT1 = 0;
+	TCCR1B = _BV(WGM12) | _BV(CS10);
+	DDRB |= _BV(PB5);
+
+	TIFR1 = _BV(OCF1B);
+	TIMSK1 |= _BV(OCIE1B);
+
+	// the PWM analogWrite() set up on SPEAKER and JOYA is gone until end()
+	pwm_connected &= ~(_BV(TIMER1A) | _BV(TIMER1B));
+	SREG = oldSREG;
+}
+
+/*
+NAME:      | end
+PURPOSE:   | Stops playback and gives timer 1 back in the state begin() found it
+ARGUMENTS: | None
+RETURNS:   | None
+*/
+void BF_Audio::end(void)
+{
+	if (!Running)
+		return;
+
+	stop();
+
+	uint8_t oldSREG = SREG;
+	cli();
+	TIMSK1 &= ~_BV(OCIE1B);
+	TCCR1A = 0;
+	PORTB &= ~_BV(PB5);
+
+	// Restart from the bottom so no period overshoots the restored top
+	timer1_load(SavedTCCR1A, SavedTCCR1B, SavedICR1, SavedOCR1A, SavedOCR1B);
+	pwm_connected |= SavedPWM;
+	Running = 0;
+	SREG = oldSREG;
+}
+
+/*
+NAME:      | play
+PURPOSE:   | Starts playing whatever is passed to write()
+ARGUMENTS: | format - AUDIO_PCM8 or AUDIO_ADPCM4
+RETURNS:   | None
+*/
+void BF_Audio::play(uint8_t format)
+{
+	stop();
+	RingHead = RingTail = 0;
+	Underruns = 0;
+	startSource(SOURCE_RING, format);
+}
+
+/*
+NAME:      | write
+PURPOSE:   | Queues a byte of sound data for play()
+ARGUMENTS: | data - one PCM sample or two ADPCM samples
+RETURNS:   | 1 if the byte was queued, 0 if the buffer is full
+*/
+uint8_t BF_Audio::write(uint8_t data)
+{
+	uint8_t i = (RingHead + 1) & (AUDIO_BUFFER_SIZE - 1);
+
+	if (i == RingTail)
+		return 0;
+	Ring[RingHead] = data;
+	RingHead = i;
+	return 1;
+}
+
+/*
+NAME:      | space
+PURPOSE:   | Reports how many bytes write() can take without blocking
+ARGUMENTS: | None
+RETURNS:   | Free space in the buffer
+*/
+uint8_t BF_Audio::space(void)
+{
+	return (RingTail - RingHead - 1) & (AUDIO_BUFFER_SIZE - 1);
+}
+
+/*
+NAME:      | playFlash
+PURPOSE:   | Plays a clip stored in the DataFlash, reading it a byte at a
+           | time from the interrupt
+ARGUMENTS: | page, offset - where the clip starts
+           | length - bytes in the clip
+           | format - AUDIO_PCM8 or AUDIO_ADPCM4
+RETURNS:   | None
+*/
+void BF_Audio::playFlash(uint16_t page, uint16_t offset, unsigned long length, uint8_t format)
+{
+	stop();
+	DataFlash.ContFlashReadEnable(page, offset);
+	FlashLeft = length;
+	startSource(SOURCE_FLASH, format);
+}
+
+/*
+NAME:      | voice
+PURPOSE:   | Starts or retunes a DDS oscillator; all voices are mixed.
+           | Does nothing until begin() has been called
+ARGUMENTS: | v - voice number, 0 to AUDIO_VOICES - 1
+           | frequency - in Hz, up to half the sample rate
+           | wave - one cycle of 256 signed samples in program memory
+RETURNS:   | None
+*/
+void BF_Audio::voice(uint8_t v, unsigned int frequency, const prog_int8_t *wave)
+{
+	// the increment depends on the sample rate, which begin() sets
+	if (v >= AUDIO_VOICES || SampleRate == 0)
+		return;
+
+	if (Source != SOURCE_DDS) {
+		stop();
+		startSource(SOURCE_DDS, AUDIO_PCM8);
+	}
+
+	uint8_t oldSREG = SREG;
+	cli();
+	Wave[v] = wave;
+	Increment[v] = ((unsigned long)frequency << 16) / SampleRate;
+	SREG = oldSREG;
+}
+
+/*
+NAME:      | voiceOff
+PURPOSE:   | Silences a DDS oscillator
+ARGUMENTS: | v - voice number
+RETURNS:   | None
+*/
+void BF_Audio::voiceOff(uint8_t v)
+{
+	if (v < AUDIO_VOICES)
+		Increment[v] = 0;
+}
+
+/*
+NAME:      | stop
+PURPOSE:   | Stops whatever is playing and lets the DataFlash go
+ARGUMENTS: | None
+RETURNS:   | None
+*/
+void BF_Audio::stop(void)
+{
+	uint8_t oldSREG = SREG;
+
+	cli();
+	if (Source == SOURCE_FLASH)
+		DataFlash.Deactivate();
+	Source = SOURCE_NONE;
+	for (uint8_t v = 0; v < AUDIO_VOICES; v++) {
+		Increment[v] = 0;
+		Phase[v] = 0;
+	}
+	Sample = 0;
+	SREG = oldSREG;
+}
+
+/*
+NAME:      | playing
+PURPOSE:   | Reports whether a clip or voice is playing. A play() stream
+           | counts as playing until stop(), even if the buffer runs dry.
+ARGUMENTS: | None
+RETURNS:   | true while playing
+*/
+bool BF_Audio::playing(void)
+{
+	return Source != SOURCE_NONE;
+}
+
+/*
+NAME:      | underruns
+PURPOSE:   | Reports how often the interrupt found the play() buffer empty
+ARGUMENTS: | None
+RETURNS:   | Count since play(), stopping at 255
+*/
+uint8_t BF_Audio::underruns(void)
+{
+	return Underruns;
+}
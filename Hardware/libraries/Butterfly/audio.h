@@ -0,0 +1,62 @@
+/* AVR Butterfly audio library
+
+	Plays sampled sound and synthesised tones on the piezo speaker. Timer 1
+	runs in 8 bit fast PWM with no prescaling, the highest carrier the clock
+	allows (31.25kHz at 8MHz), and its duty cycle on SPEAKER (OC1A) is the
+	sample value. The timer 1 compare B interrupt fires once per carrier
+	period and loads a new sample every few periods, so the sample rate is
+	the carrier divided down to the nearest whole number.
+
+	Samples come from one of three sources:
+	  - a small ring buffer the sketch fills with write(),
+	  - the DataFlash, read straight from a continuous array read in the
+	    interrupt, so a clip of any length costs no buffer at all,
+	  - up to AUDIO_VOICES DDS oscillators reading 256 entry wavetables.
+	Ring and DataFlash data may be unsigned 8 bit PCM or 4 bit IMA ADPCM.
+
+	Timer 1 is taken over while the engine runs, so tone(), analogWrite()
+	on SPEAKER or JOYA, and input capture can't be used at the same time.
+	The DataFlash is selected for as long as a clip plays from it.
+ */
+
+#ifndef audio_h
+#define audio_h
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+// Sample formats
+#define AUDIO_PCM8    0   // one unsigned sample per byte
+#define AUDIO_ADPCM4  1   // IMA ADPCM, two samples per byte, low nibble first
+
+#define AUDIO_VOICES  4
+
+// Bytes buffered between write() and the interrupt; must be a power of two.
+#define AUDIO_BUFFER_SIZE 32
+
+// One cycle of a sine wave, signed, for voice()
+extern const prog_int8_t AudioSine[256];
+
+class BF_Audio
+{
+public:
+	void begin(unsigned int sampleRate = 8000);
+	void end(void);
+
+	void play(uint8_t format);
+	uint8_t write(uint8_t data);
+	uint8_t space(void);
+
+	void playFlash(uint16_t page, uint16_t offset, unsigned long length, uint8_t format);
+
+	void voice(uint8_t v, unsigned int frequency, const prog_int8_t *wave = AudioSine);
+	void voiceOff(uint8_t v);
+
+	void stop(void);
+	bool playing(void);
+	uint8_t underruns(void);
+};
+
+extern BF_Audio Audio;
+
+#endif
@@ -2,6 +2,11 @@
 #ifndef BF_EEPROM_H_
 #define BF_EEPROM_H_
 
+// The core keeps its cached OSCCAL calibration in the last two bytes of
+// EEPROM (E2END - 1 and E2END; see OSCCAL_EEPROM_ADDR in osccal.h).
+// Writing over them only costs a full calibration at the next reset, but
+// they are best left out of the range used here.
+
 void LoadEEPROM(char *pBuffer, char num_bytes, unsigned char *EE_START_ADR);
 void StoreEEPROM(char *pBuffer, char num_bytes, unsigned char *EE_START_ADR);
 
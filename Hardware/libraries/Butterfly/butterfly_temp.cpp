@@ -5,47 +5,38 @@
 //#include "tempslookup.h"
 
 
-// This table is from the AVR Butterfly sample from ATMEL
-// http://www.avrfreaks.net/index.php?name=PNphpBB2&file=viewtopic&p=397642#397642
-extern const prog_uint16_t PROGMEM TEMP_Fahrenheit_pos[];
-const prog_uint16_t TEMP_Fahrenheit_pos[] =  
-{ // Positive Fahrenheit temps (ADC-value) for 0 to 140 degrees F  
-938, 935, 932, 929, 926, 923, 920, 916, 913, 909, 906, 902, 898, 
-894, 891, 887, 882, 878, 874, 870, 865, 861, 856, 851, 847, 842, 
-837, 832, 827, 822, 816, 811, 806, 800, 795, 789, 783, 778, 772, 
-766, 760, 754, 748, 742, 735, 729, 723, 716, 710, 703, 697, 690, 
-684, 677, 670, 663, 657, 650, 643, 636, 629, 622, 616, 609, 602, 
-595, 588, 581, 574, 567, 560, 553, 546, 539, 533, 526, 519, 512, 
-505, 498, 492, 485, 478, 472, 465, 459, 452, 446, 439, 433, 426, 
-420, 414, 408, 402, 396, 390, 384, 378, 372, 366, 360, 355, 349, 
-344, 338, 333, 327, 322, 317, 312, 307, 302, 297, 292, 287, 282, 
-277, 273, 268, 264, 259, 255, 251, 246, 242, 238, 234, 230, 226, 
-222, 219, 215, 211, 207, 204, 200, 197, 194, 190, 187, 
-};
-
-// http://www.avrfreaks.net/index.php?name=PNphpBB2&file=viewtopic&p=397642#397642
-// This table is from the AVR Butterfly sample from ATMEL
-extern const prog_uint16_t PROGMEM TEMP_Celsius_pos[];
-const prog_uint16_t TEMP_Celsius_pos[] =    
-{ // Positive Celsius temps (ADC-value) for 0 to 60 degrees C
-806,796,786,775,765,754,743,732,720,709,697,685,673,661,649,
-636,624,611,599,586,574,562,549,537,524,512,500,488,476,464,
-452,440,429,418,406,396,385,374,364,354,344,334,324,315,306,
-297,288,279,271,263,255,247,240,233,225,219,212,205,199,193,
-187,
-};
+// Replaces the Fahrenheit and Celsius tables from the Atmel Butterfly
+// sample, which stopped at -15 C.  Regenerate with different thermistor
+// coefficients if the sensor calls for it.
+#define TEMP_MIN -40
+#define TEMP_MAX 125
 
-// http://www.avrfreaks.net/index.php?name=PNphpBB2&file=viewtopic&p=397642#397642
-extern const prog_uint16_t PROGMEM TEMP_Celsius_neg[];    
-const prog_uint16_t TEMP_Celsius_neg[] =    
-{  // Negative Celsius temps (ADC-value) from -1 to -15 degrees C
-815,825,834,843,851,860,868,876,883,891,898,904,911,917,923,
+// Generated by tools/temptable.py; 12 bit ADC readings for -40 to 125
+// degrees C, one per degree
+extern const prog_uint16_t PROGMEM TEMP_Celsius[];
+const prog_uint16_t TEMP_Celsius[] =
+{
+4020, 4014, 4008, 4001, 3994, 3986, 3978, 3969, 3960, 3950, 3939, 3928,
+3916, 3904, 3891, 3877, 3862, 3846, 3830, 3813, 3795, 3776, 3756, 3735,
+3713, 3691, 3667, 3642, 3616, 3589, 3561, 3532, 3502, 3471, 3438, 3405,
+3370, 3335, 3298, 3261, 3222, 3182, 3142, 3100, 3058, 3014, 2970, 2925,
+2880, 2833, 2787, 2739, 2691, 2643, 2594, 2544, 2495, 2445, 2396, 2346,
+2296, 2246, 2196, 2147, 2097, 2048, 1999, 1951, 1903, 1855, 1808, 1762,
+1716, 1671, 1626, 1583, 1539, 1497, 1456, 1415, 1375, 1336, 1297, 1260,
+1223, 1187, 1152, 1118, 1085, 1052, 1021,  990,  960,  931,  903,  875,
+ 848,  822,  797,  772,  749,  726,  703,  682,  661,  640,  620,  601,
+ 583,  565,  547,  530,  514,  498,  483,  468,  454,  440,  427,  414,
+ 401,  389,  377,  366,  355,  344,  334,  324,  315,  305,  296,  288,
+ 279,  271,  263,  255,  248,  241,  234,  227,  221,  215,  208,  203,
+ 197,  191,  186,  181,  176,  171,  166,  162,  157,  153,  149,  145,
+ 141,  137,  134,  130,  127,  123,  120,  117,  114,  111,
 };
 
 TempSensor::TempSensor(int units)
 {
     this->units = units;
     overSample = false;
+    highRes = false;
 }
 
 int TempSensor::getTemp()
@@ -55,61 +46,69 @@ int TempSensor::getTemp()
 
 int TempSensor::getTemp(int units)
 {
-  // get the first sample from the temp sensor
-  int v = analogRead(TEMP);
-
-  // if using oversampling add 7 more samples and then divide by 8
-  if(overSample){
-    for(int i=0; i<7; i++)    
-      v += analogRead(TEMP);
-    v = v >> 3;
-  }
-  
-  // convert the a2d reading to temperature, depending on units setting
-  switch (units) {
-    case CELSIUS:
-      v = mapToC(v);
-      break;
-      
-    case FAHRENHEIT:
-      v = mapToF(v);
-      break;
-  }
-  
+  int v = getTempTenths(units);
+
+  // round to the nearest whole degree
+  return (v + (v < 0 ? -5 : 5)) / 10;
+}
+
+int TempSensor::getTempTenths()
+{
+  return getTempTenths(this->units);
+}
+
+int TempSensor::getTempTenths(int units)
+{
+  int v = toTenthsC(readSensor());
+
+  if (units == FAHRENHEIT)
+    v = (v * 9 + (v < 0 ? -2 : 2)) / 5 + 320;
+
   return v;
 }
 
-int TempSensor::mapToF(int a2d)
-{  
-  int i;
-  for (i=0; i<=141; i++){   // Find the temperature
-    if ((prog_uint16_t)a2d > pgm_read_word_near( TEMP_Fahrenheit_pos +i )){
-       break;
-    }
-  }     
-  return i;
+// Returns a 12 bit reading of the temp sensor
+unsigned int TempSensor::readSensor()
+{
+  // sample the temp sensor with the CPU asleep, which keeps the reading
+  // quiet enough that oversampling is rarely needed; if it is on, average
+  // 8 samples.  highRes takes a 12 bit reading from 16 samples.
+  if(highRes)
+    return analogReadHighRes(TEMP, 2);
+  else if(overSample)
+    return Sampler.readQuiet(TEMP, 8) >> 1;
+  else
+    return analogReadQuiet(TEMP) << 2;
 }
 
-int TempSensor::mapToC(int a2d)
+// Converts a 12 bit reading to tenths of a degree C.  A binary search
+// finds the whole degrees either side of it, then it's interpolated
+// between them.
+int TempSensor::toTenthsC(unsigned int a2d)
 {
-  int v = 0;
-  if( a2d > 810){   // If it's a negative temperature
-    for (int i=0; i<=25; i++){   // Find the temperature
-      if ((prog_uint16_t)a2d <= pgm_read_word_near( TEMP_Celsius_neg + i)){
-        v = 0-i; // Make it negative
-        break;
-      }
-    }
-  } 
-  else if ( a2d < 800 ) {  // If it's a positive temperature
-    for (int i=0; i<100; i++) {
-      if ((prog_uint16_t)a2d >= pgm_read_word_near( TEMP_Celsius_pos + i)){
-        v = i; 
-        break;
-      }
-    }        
+  uint8_t lo = 0;
+  uint8_t hi = TEMP_MAX - TEMP_MIN;
+  uint8_t mid;
+  unsigned int upper, lower;
+
+  // readings rise as the temperature falls
+  if (a2d >= pgm_read_word_near(TEMP_Celsius + lo))
+    return TEMP_MIN * 10;
+  if (a2d <= pgm_read_word_near(TEMP_Celsius + hi))
+    return TEMP_MAX * 10;
+
+  while (hi - lo > 1) {
+    mid = (lo + hi) >> 1;
+    if (pgm_read_word_near(TEMP_Celsius + mid) >= a2d)
+      lo = mid;
+    else
+      hi = mid;
   }
-  return v;
+
+  upper = pgm_read_word_near(TEMP_Celsius + lo);
+  lower = pgm_read_word_near(TEMP_Celsius + hi);
+  return (TEMP_MIN + lo) * 10 +
+    (int)(((upper - a2d) * 10 + (upper - lower) / 2) / (upper - lower));
 }
 
 // Set up an instance 
@@ -12,11 +12,14 @@ class TempSensor
     TempSensor(int units);
     int getTemp();
     int getTemp(int units);
+    int getTempTenths();
+    int getTempTenths(int units);
     bool overSample;
+    bool highRes;
     int units;
   private:
-    int mapToF(int a2d);
-    int mapToC(int a2d);    
+    unsigned int readSensor();
+    int toTenthsC(unsigned int a2d);
 };
 
 extern TempSensor TempSense;
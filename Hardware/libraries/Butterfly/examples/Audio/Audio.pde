@@ -0,0 +1,47 @@
+/*
+ * Audio
+ *
+ * Plays a chord on the DDS voices, then a rising sawtooth fed
+ * a sample at a time through the play buffer. The sound is made
+ * by timer 1 and its interrupt, so loop() only has to keep the
+ * buffer topped up.
+ *
+ */
+
+#include <audio.h>
+#include <dataflash.h>
+
+void setup() {
+  Audio.begin(8000);
+}
+
+void chord() {
+  // C major, one voice per note
+  Audio.voice(0, 262);
+  Audio.voice(1, 330);
+  Audio.voice(2, 392);
+  delay(1000);
+  Audio.stop();
+}
+
+void sweep() {
+  unsigned int phase = 0;
+  unsigned int step = 256;
+
+  Audio.play(AUDIO_PCM8);
+  while (step < 4096) {
+    // write() never blocks; just skip ahead while the buffer is full
+    if (Audio.write(phase >> 8)) {
+      phase += step;
+      step++;
+    }
+  }
+  Audio.stop();
+}
+
+void loop() {
+  chord();
+  delay(500);
+  sweep();
+  delay(500);
+}
@@ -33,14 +33,14 @@ bool test()
 
 void setup()
 {
-  LCD.prints("flash test");
+  LCD.prints(F("flash test"));
   delay(2000);
 
   LCD.clear();
   if (test())
-    LCD.prints("Success");  
+    LCD.prints(F("Success"));  
   else
-    LCD.prints("Failure");
+    LCD.prints(F("Failure"));
 }
 
 void loop()
@@ -4,14 +4,14 @@
 
 void setup()
 {
-  // Print a string from program memory. Faster than print, 
-  // and uses less ram than prints
-  LCD.prints_f(PSTR("BUTTERDUINO"));
+  // Print a string from program memory. Wrapping a string in F()
+  // keeps it out of RAM, and prints() is faster than print().
+  LCD.prints(F("BUTTERDUINO"));
   delay( 3000 );
   
-  // Print a string from RAM. Faster than print, and can
-  // print strings that are not set at compile time.
-  LCD.prints("TEMP Sensor");
+  // prints() replaces whatever is on the display. Strings that are
+  // not set at compile time can be passed to it straight from RAM.
+  LCD.prints(F("TEMP Sensor"));
   delay( 3000 );
   
   // Set up the RTC timer to call the secTick() function every second.
@@ -25,7 +25,7 @@ void secTick()
   // will append to whatever is on the display. println() will cause
   // the display to be cleared before the next character is printed.
   LCD.print( TempSense.getTemp(FAHRENHEIT) );
-  LCD.println( " F" );
+  LCD.println( F(" F") );
 }
 
 void loop()
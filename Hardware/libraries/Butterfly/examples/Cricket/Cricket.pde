@@ -8,13 +8,12 @@
 // Uncomment this #define to see various parameters on the serial port
 // #define debug
 
-// This is close to the number of microseconds per half-cycle of the
-// cricket's 2.9kHz carrier frequency, which is about 172uS. Because
-// the pizeo speaker is being driven with a square wave the audible
-// pitch does not sound like a 2.9kHz sine wave. The 125uS delay sounds
-// closer to the cricket chirp, and seems to work well with the piezo
-// speaker as well. Feel free to adjust it up or down to hear the change.
-int chirpFreq = 125;
+// The cricket's carrier frequency is about 2.9kHz. Because the pizeo
+// speaker is being driven with a square wave the audible pitch does not
+// sound like a 2.9kHz sine wave. 4kHz sounds closer to the cricket chirp,
+// and seems to work well with the piezo speaker as well. Feel free to
+// adjust it up or down to hear the change.
+int chirpFreq = 4000;
 int light;
 
 void setup()
@@ -31,15 +30,9 @@ void setup()
 // A chirp chip is composed of a few mS of 2.9kHz carrier.
 void pulse(int duration)
 {  
-  unsigned long term = millis() + duration;
- 
-  while ( millis() < term)
-  {
-    digitalWrite( SPEAKER, HIGH );
-    delayMicroseconds( chirpFreq );
-    digitalWrite( SPEAKER, LOW );
-    delayMicroseconds( chirpFreq );
-  }
+  // timer 1 generates the carrier and stops it after duration mS
+  tone( SPEAKER, chirpFreq, duration );
+  delay( duration );
 }
 
 // chipA is a two-pulse construct.
@@ -115,11 +108,11 @@ void song(long songLength)
   int breakLight = analogRead(LIGHT) - 80;
   
 #ifdef debug
-  Serial.print("Temp: ");
+  Serial.print(F("Temp: "));
   Serial.println(temp, DEC);
-  Serial.print("Chirps: ");
+  Serial.print(F("Chirps: "));
   Serial.println(chirpCount, DEC);
-  Serial.print("Chirp delay: ");
+  Serial.print(F("Chirp delay: "));
   Serial.println(chirpDelay, DEC);
 #endif
   
@@ -135,13 +128,13 @@ void song(long songLength)
     // Crickets go quiet if it gets too bright.
     int lite = analogRead(LIGHT);
 #ifdef debug
-    Serial.print("Light: ");
+    Serial.print(F("Light: "));
     Serial.println(lite, DEC);
 #endif
     if ( lite < breakLight )
     {
 #ifdef debug
-      Serial.println("Scared!");
+      Serial.println(F("Scared!"));
 #endif
       return;
     }
@@ -156,7 +149,7 @@ void loop()
   light = analogRead( LIGHT );
   
 #ifdef debug
-  Serial.print("Light: ");
+  Serial.print(F("Light: "));
   Serial.println(light, DEC);
 #endif
   
@@ -166,7 +159,7 @@ void loop()
     // Sing for 10 to 90 seconds
     duration = random( 10 * 1000, 90 * 1000 );
 #ifdef debug
-    Serial.print("Sing: ");
+    Serial.print(F("Sing: "));
     Serial.println(duration, DEC);
 #endif    
     song( duration );
@@ -175,7 +168,7 @@ void loop()
   // Then be silent for 30 to 300 seconds
   duration = random( 30, 300 ) * 1000;
 #ifdef debug
-  Serial.print("Rest: ");
+  Serial.print(F("Rest: "));
   Serial.println(duration, DEC);
 #endif  
   delay( duration );      
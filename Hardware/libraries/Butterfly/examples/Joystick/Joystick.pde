@@ -0,0 +1,28 @@
+#include <joystick.h>
+#include <LCD_Driver.h>
+
+// Show joystick events on the LCD. loop() sleeps between events
+// instead of polling the joystick pins.
+
+void setup()
+{
+  Joystick.begin();
+  LCD.prints(F("JOYSTICK"));
+}
+
+void loop()
+{
+  uint8_t event = Joystick.wait();
+
+  if (JOY_TYPE(event) == JOY_RELEASE)
+    return;
+
+  switch (JOY_KEY(event))
+  {
+    case JOY_CENTER: LCD.prints(F("CENTER")); break;
+    case JOY_UP:     LCD.prints(F("UP"));     break;
+    case JOY_DOWN:   LCD.prints(F("DOWN"));   break;
+    case JOY_LEFT:   LCD.prints(F("LEFT"));   break;
+    case JOY_RIGHT:  LCD.prints(F("RIGHT"));  break;
+  }
+}
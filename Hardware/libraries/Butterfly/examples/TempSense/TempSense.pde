@@ -14,25 +14,37 @@ void setup() {
 }
 
 void doSamples(){
-  Serial.print("Default: ");
+  Serial.print(F("Default: "));
   Serial.println( TempSense.getTemp() );  
   
-  Serial.print("CELSIUS: ");
+  Serial.print(F("CELSIUS: "));
   Serial.println( TempSense.getTemp(CELSIUS) );  
 
-  Serial.print("FAHRENHEIT: ");
+  Serial.print(F("FAHRENHEIT: "));
   Serial.println( TempSense.getTemp(FAHRENHEIT) );  
+
+  // tenths of a degree, interpolated between table entries
+  int t = TempSense.getTempTenths(CELSIUS);
+  Serial.print(F("CELSIUS: "));
+  // print the sign separately, or -0.5 would come out as 0.5
+  if (t < 0) {
+    Serial.print('-');
+    t = -t;
+  }
+  Serial.print( t / 10 );
+  Serial.print('.');
+  Serial.println( t % 10 );
 }
 
 void loop() {  
-  Serial.println("** With oversampling off **");
+  Serial.println(F("** With oversampling off **"));
   doSamples();
   
-  Serial.println("** With oversampling on **");
+  Serial.println(F("** With oversampling on **"));
   TempSense.overSample = true;
   doSamples();
 
-  Serial.println("** Reset default **");
+  Serial.println(F("** Reset default **"));
   TempSense.units = FAHRENHEIT;
   doSamples();
 
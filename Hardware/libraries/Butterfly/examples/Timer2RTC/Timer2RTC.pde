@@ -1,11 +1,15 @@
 #include <timer2_RTC.h>
 
+// set by the tick callback, which runs in the timer interrupt, and
+// cleared by loop() once the time has been printed
+volatile boolean ticked = false;
+
 void setup() 
 { 
   pinMode(SPEAKER, OUTPUT);  
   
   Serial.begin(9600); 
-  Serial.println("Butterfly RTC Example");
+  Serial.println(F("Butterfly RTC Example"));
 
 // The RTCTimer can be started with no 'tick' callback. In this
 // case you must check regularly to see if the time has changed.
@@ -19,16 +23,28 @@ void setup()
 
 void secTick()
 {
+  // the callback runs inside the timer interrupt, so leave the serial
+  // output to loop(); printing here could wait forever on a full buffer
   beep();
+  ticked = true;
+}
+
+void printTime()
+{
   Serial.print(RTCTimer.hour, DEC);
-  Serial.print(":");
+  Serial.print(':');
   Serial.print(RTCTimer.minute, DEC);
-  Serial.print(":");
+  Serial.print(':');
   Serial.println(RTCTimer.second, DEC);
 }
 
 void loop()
 {
+  if (ticked) {
+    ticked = false;
+    printTime();
+  }
+
   /*  
   // When you are not using the 'tick' callback, you may
   // check the RTCTimer.timeChanged variable to see if
@@ -37,7 +53,8 @@ void loop()
   // can reset timeChanged at any time, or you may leave
   // it to overflow when it reaches a value of 255.
   if (RTCTimer.timeChanged > 0){
-    secTick();
+    beep();
+    printTime();
     RTCTimer.timeChanged = 0;
   }
   //*/
@@ -45,11 +62,7 @@ void loop()
 
 void beep()
 {
-  for (int i=0; i<20; i++)
-  {
-      digitalWrite(SPEAKER,HIGH);
-      delayMicroseconds(50);
-      digitalWrite(SPEAKER,LOW);
-      delayMicroseconds(50);    
-  }
+  // a short 10kHz click; tone() returns at once, so this is safe to
+  // call from the tick callback
+  tone(SPEAKER, 10000, 2);
 }
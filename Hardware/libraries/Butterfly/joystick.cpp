@@ -0,0 +1,231 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <avr/pgmspace.h>
+#include <wiring.h>
+
+#include "joystick.h"
+
+// An instance of the joystick
+BF_Joystick Joystick = BF_Joystick();
+
+// Pin change number, port and bit of each key
+static const uint8_t PROGMEM JoyPCINT[JOY_KEYS] = { PCINT_JOYCENTER, PCINT_JOYA, PCINT_JOYB, PCINT_JOYLEFT, PCINT_JOYRIGHT };
+
+static volatile unsigned long EdgeTime[JOY_KEYS];   // millis() at the last edge
+static volatile unsigned long RepeatTime[JOY_KEYS]; // millis() when the next repeat is due
+static volatile uint8_t  Pending  = 0;              // keys that have bounced and not settled
+static volatile uint8_t  Pressed  = 0;              // debounced state of each key
+static volatile uint8_t  Running  = 0;
+
+// Single producer (the tick ISR), single consumer (the sketch) queue. Each
+// side only writes its own index, so no locking is needed.
+static volatile uint8_t  Queue[JOY_QUEUE_SIZE];
+static volatile uint8_t  QueueHead = 0;
+static volatile uint8_t  QueueTail = 0;
+static volatile uint8_t  Overruns  = 0;
+
+// Contacts close to ground, so a key is down when its pin is low.
+static inline bool keyDown(uint8_t key)
+{
+	switch (key) {
+	case JOY_CENTER: return !(PINB & _BV(PB4));
+	case JOY_UP:     return !(PINB & _BV(PB6));
+	case JOY_DOWN:   return !(PINB & _BV(PB7));
+	case JOY_LEFT:   return !(PINE & _BV(PE2));
+	default:         return !(PINE & _BV(PE3));
+	}
+}
+
+static inline void keyEdge(uint8_t key)
+{
+	EdgeTime[key] = millis();
+	Pending |= _BV(key);
+}
+
+static void centerEdge(void) { keyEdge(JOY_CENTER); }
+static void upEdge(void)     { keyEdge(JOY_UP); }
+static void downEdge(void)   { keyEdge(JOY_DOWN); }
+static void leftEdge(void)   { keyEdge(JOY_LEFT); }
+static void rightEdge(void)  { keyEdge(JOY_RIGHT); }
+
+static void (* const EdgeHandler[JOY_KEYS])(void) = { centerEdge, upEdge, downEdge, leftEdge, rightEdge };
+
+static void push(uint8_t event)
+{
+	uint8_t i = (QueueHead + 1) & (JOY_QUEUE_SIZE - 1);
+
+	if (i == QueueTail) {
+		if (Overruns < 255)
+			Overruns++;
+		return;
+	}
+	Queue[QueueHead] = event;
+	QueueHead = i;
+}
+
+// Timer 0 compare match happens once per timer 0 period, the same rate the
+// millis() count is advanced at. The compare interrupt is used rather than
+// the overflow so the core's tick is left alone.
+ISR(TIMER0_COMP_vect)
+{
+	Joystick.tick();
+}
+
+/*
+NAME:      | begin
+PURPOSE:   | Turns on the pull-ups and arms the pin change and tick interrupts
+ARGUMENTS: | None
+RETURNS:   | None
+*/
+void BF_Joystick::begin(void)
+{
+	uint8_t key;
+
+	// Inputs with pull-ups
+	DDRB  &= ~(_BV(PB4) | _BV(PB6) | _BV(PB7));
+	PORTB |=   _BV(PB4) | _BV(PB6) | _BV(PB7);
+	DDRE  &= ~(_BV(PE2) | _BV(PE3));
+	PORTE |=   _BV(PE2) | _BV(PE3);
+
+	cli();
+	QueueHead = QueueTail = 0;
+	Overruns = 0;
+	Pending = 0;
+	Pressed = 0;
+	for (key = 0; key < JOY_KEYS; key++)
+		if (keyDown(key))
+			Pressed |= _BV(key);
+	sei();
+
+	for (key = 0; key < JOY_KEYS; key++)
+		attachPinChangeInterrupt(pgm_read_byte(&JoyPCINT[key]), EdgeHandler[key], CHANGE);
+
+	Running = 1;
+	TIMSK0 |= _BV(OCIE0A);
+}
+
+/*
+NAME:      | end
+PURPOSE:   | Stops watching the joystick
+ARGUMENTS: | None
+RETURNS:   | None
+*/
+void BF_Joystick::end(void)
+{
+	TIMSK0 &= ~_BV(OCIE0A);
+	Running = 0;
+	for (uint8_t key = 0; key < JOY_KEYS; key++)
+		detachPinChangeInterrupt(pgm_read_byte(&JoyPCINT[key]));
+}
+
+/*
+NAME:      | tick
+PURPOSE:   | Advances each key's debounce and repeat timing. Called from the
+			 timer 0 compare ISR.
+ARGUMENTS: | None
+RETURNS:   | None
+*/
+void BF_Joystick::tick(void)
+{
+	unsigned long now = millis();
+	uint8_t key, bit;
+
+	for (key = 0, bit = 1; key < JOY_KEYS; key++, bit <<= 1) {
+		if (Pending & bit) {
+			// Wait for the contact to stop bouncing
+			if (now - EdgeTime[key] < JOY_DEBOUNCE_MS)
+				continue;
+			Pending &= ~bit;
+
+			if (keyDown(key) && !(Pressed & bit)) {
+				Pressed |= bit;
+				RepeatTime[key] = now + JOY_REPEAT_DELAY_MS;
+				push(JOY_PRESS | key);
+			} else if (!keyDown(key) && (Pressed & bit)) {
+				Pressed &= ~bit;
+				push(JOY_RELEASE | key);
+			}
+		} else if ((Pressed & bit) && (long)(now - RepeatTime[key]) >= 0) {
+			RepeatTime[key] = now + JOY_REPEAT_RATE_MS;
+			push(JOY_REPEAT | key);
+		}
+	}
+}
+
+/*
+NAME:      | available
+PURPOSE:   | Number of events waiting to be read
+ARGUMENTS: | None
+RETURNS:   | Event count
+*/
+uint8_t BF_Joystick::available(void)
+{
+	return (QueueHead - QueueTail) & (JOY_QUEUE_SIZE - 1);
+}
+
+/*
+NAME:      | read
+PURPOSE:   | Takes the next event from the queue
+ARGUMENTS: | None
+RETURNS:   | The event (see JOY_KEY and JOY_TYPE), or 0 if there is none
+*/
+uint8_t BF_Joystick::read(void)
+{
+	uint8_t event;
+
+	if (QueueHead == QueueTail)
+		return 0;
+
+	event = Queue[QueueTail];
+	QueueTail = (QueueTail + 1) & (JOY_QUEUE_SIZE - 1);
+	return event;
+}
+
+/*
+NAME:      | wait
+PURPOSE:   | Sleeps in idle mode until an event arrives, then reads it
+ARGUMENTS: | None
+RETURNS:   | The event, or 0 if the joystick isn't running
+*/
+uint8_t BF_Joystick::wait(void)
+{
+	set_sleep_mode(SLEEP_MODE_IDLE);
+
+	for (;;) {
+		cli();
+		if (!Running || QueueHead != QueueTail)
+			break;
+		// Interrupts are enabled by sei right before sleep, so a tick that
+		// queues an event can't slip in between the test and the sleep.
+		sleep_enable();
+		sei();
+		sleep_cpu();
+		sleep_disable();
+	}
+	sei();
+
+	return read();
+}
+
+/*
+NAME:      | isPressed
+PURPOSE:   | Debounced state of a key
+ARGUMENTS: | Key number
+RETURNS:   | true if the key is held down
+*/
+bool BF_Joystick::isPressed(uint8_t key)
+{
+	return (Pressed & _BV(key)) != 0;
+}
+
+/*
+NAME:      | overruns
+PURPOSE:   | Number of events dropped because the queue was full
+ARGUMENTS: | None
+RETURNS:   | Dropped event count
+*/
+uint8_t BF_Joystick::overruns(void)
+{
+	return Overruns;
+}
@@ -0,0 +1,59 @@
+/* AVR Butterfly joystick library
+
+	Reads the five joystick contacts through pin change interrupts instead
+	of polling. Each edge is timestamped in the pin change ISR; a per-key
+	state machine, ticked from timer 0 at the same rate as millis(), waits
+	for the contact to settle before reporting it. Press, release and
+	auto-repeat events go into a small queue that loop() can read, or
+	sleep on with wait().
+
+	begin() must be called from setup(), since init() turns off the pin
+	change interrupt the bootloader leaves on.
+ */
+
+#ifndef joystick_h
+#define joystick_h
+
+#include <stdint.h>
+
+// Keys
+#define JOY_CENTER   0
+#define JOY_UP       1
+#define JOY_DOWN     2
+#define JOY_LEFT     3
+#define JOY_RIGHT    4
+#define JOY_KEYS     5
+
+// Event types
+#define JOY_PRESS    0x10
+#define JOY_RELEASE  0x20
+#define JOY_REPEAT   0x30
+
+// An event is a key number and event type in one byte. 0 means no event.
+#define JOY_KEY(e)   ((e) & 0x0F)
+#define JOY_TYPE(e)  ((e) & 0xF0)
+
+#define JOY_DEBOUNCE_MS      20   // contact must be steady this long
+#define JOY_REPEAT_DELAY_MS  500  // hold time before the first repeat
+#define JOY_REPEAT_RATE_MS   100  // time between repeats after that
+
+// Number of events queued between reads; must be a power of two.
+#define JOY_QUEUE_SIZE       8
+
+class BF_Joystick
+{
+public:
+	void begin(void);
+	void end(void);
+	uint8_t available(void);
+	uint8_t read(void);
+	uint8_t wait(void);
+	bool isPressed(uint8_t key);
+	uint8_t overruns(void);
+
+	void tick(void);
+};
+
+extern BF_Joystick Joystick;
+
+#endif
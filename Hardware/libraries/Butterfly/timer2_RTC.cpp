@@ -1,6 +1,7 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include <wiring.h>
+#include <osccal.h>
 
 #include "timer2_RTC.h"
 
@@ -29,6 +30,7 @@ ISR(TIMER2_OVF_vect) {
 
 Timer2RTC::Timer2RTC( void )
 {
+	oscillatorTracking = false;
 	init(0);
 }
 
@@ -58,9 +60,21 @@ void Timer2RTC::init( ClockChangeCallback_t userCallback )
     sei();
 }
 
+void Timer2RTC::trackOscillator( bool enable )
+{
+	if (enable)
+		OSCCAL_TrackStart();
+	oscillatorTracking = enable;
+}
+
 void Timer2RTC::timerTick(void)
 {
 	static char LeapMonth;
+
+	// Keep the RC oscillator trimmed against the crystal, if requested.
+	if (oscillatorTracking)
+		OSCCAL_Track();
+
     second++;               
 
     if (second == 60) {
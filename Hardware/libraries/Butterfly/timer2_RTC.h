@@ -12,6 +12,11 @@
 	The timeChanged flag is incremented in the timerTick routine. It may
 	be monitored by the user code to react to clock changes without	attaching
 	to the ISR. The user code is responsible for resetting the flag.
+
+	Since the crystal is running anyway, it can also be used to keep the
+	CPU's RC oscillator trimmed as temperature and battery voltage change.
+	Call trackOscillator(true) to have each tick nudge OSCCAL; the measured
+	error is available in OSCCAL_Drift (see osccal.h) for logging.
  */
 
 #ifndef timer2_RTC_h
@@ -34,7 +39,11 @@ public:
 
 	Timer2RTC( void );
 	void init( ClockChangeCallback_t clockChangeCallback );
+	void trackOscillator( bool enable );
 	void timerTick();
+
+private:
+	volatile bool oscillatorTracking;
 };
 
 extern Timer2RTC RTCTimer;
@@ -0,0 +1,73 @@
+#!/usr/bin/env python
+"""Generate the TEMP_Celsius table in butterfly_temp.cpp.
+
+The Butterfly's NTC thermistor sits at the bottom of a divider with a
+fixed resistor, so the ADC reads
+
+    adc = 1024 * Rntc / (Rntc + Rfixed)
+
+and the thermistor follows the Steinhart-Hart equation
+
+    1/T = A + B ln(R) + C ln(R)^3      (T in kelvin)
+
+The table holds the reading, scaled to 12 bits, at each whole degree
+Celsius from --min to --max.  TempSensor interpolates between entries.
+
+By default A, B and C are worked out from the part's data sheet values
+(beta 4250, 100k at 25C), which reproduce Atmel's original tables to
+within a count.  Pass --abc to use measured coefficients instead.
+
+    python temptable.py > table.txt
+    python temptable.py --abc 1.1e-3 2.3e-4 8.6e-8
+"""
+
+import math
+import optparse
+
+def beta_to_abc(beta, r25):
+    return (1.0 / 298.15 - math.log(r25) / beta, 1.0 / beta, 0.0)
+
+def resistance(t, a, b, c):
+    # invert Steinhart-Hart for R; with C = 0 this reduces to the beta model
+    y = a - 1.0 / (t + 273.15)
+    if c == 0:
+        return math.exp(-y / b)
+    x = math.sqrt((b / (3.0 * c)) ** 3 + (y / (2.0 * c)) ** 2)
+    return math.exp((x - y / (2.0 * c)) ** (1.0 / 3) -
+                    (x + y / (2.0 * c)) ** (1.0 / 3))
+
+def main():
+    p = optparse.OptionParser(usage='%prog [options]')
+    p.add_option('--abc', nargs=3, type='float', metavar='A B C',
+                 help='Steinhart-Hart coefficients')
+    p.add_option('--beta', type='float', default=4250.0)
+    p.add_option('--r25', type='float', default=100e3,
+                 help='thermistor resistance at 25C')
+    p.add_option('--rfixed', type='float', default=100e3,
+                 help='fixed divider resistor')
+    p.add_option('--min', type='int', default=-40)
+    p.add_option('--max', type='int', default=125)
+    opts, args = p.parse_args()
+
+    a, b, c = opts.abc or beta_to_abc(opts.beta, opts.r25)
+
+    values = []
+    for t in range(opts.min, opts.max + 1):
+        r = resistance(t, a, b, c)
+        values.append(int(round(4096 * r / (r + opts.rfixed))))
+
+    print('#define TEMP_MIN %d' % opts.min)
+    print('#define TEMP_MAX %d' % opts.max)
+    print('')
+    print('// Generated by tools/temptable.py; 12 bit ADC readings for %d to %d'
+          % (opts.min, opts.max))
+    print('// degrees C, one per degree')
+    print('extern const prog_uint16_t PROGMEM TEMP_Celsius[];')
+    print('const prog_uint16_t TEMP_Celsius[] =')
+    print('{')
+    for i in range(0, len(values), 12):
+        print(', '.join('%4d' % v for v in values[i:i + 12]) + ',')
+    print('};')
+
+if __name__ == '__main__':
+    main()